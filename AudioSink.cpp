@@ -0,0 +1,283 @@
+#include "AudioSink.h"
+#include <SDL_audio.h>
+#include <cstring>
+
+void AudioStats::write_json(std::ostream &out) const
+{
+	out << "{\n";
+	out << "  \"callbacks\": " << callbacks << ",\n";
+	out << "  \"expected_interval_us\": " << expectedIntervalUs << ",\n";
+	out << "  \"last_interval_us\": " << lastIntervalUs << ",\n";
+	out << "  \"min_interval_us\": " << (callbacks > 1 ? minIntervalUs.load() : 0) << ",\n";
+	out << "  \"max_interval_us\": " << maxIntervalUs << ",\n";
+	out << "  \"jitter_us\": " << jitterUs << ",\n";
+	out << "  \"underruns\": " << underruns << ",\n";
+	out << "  \"underrun_samples\": " << underrunSamples << ",\n";
+	out << "  \"overruns\": " << overruns << ",\n";
+	out << "  \"tones\": " << tones << ",\n";
+	out << "  \"last_tone_delay_us\": " << lastToneDelayUs << ",\n";
+	out << "  \"min_tone_delay_us\": " << (tones > 0 ? minToneDelayUs.load() : 0) << ",\n";
+	out << "  \"max_tone_delay_us\": " << maxToneDelayUs << ",\n";
+
+	//Oldest first.
+	out << "  \"fill_history\": [";
+	uint32_t pos = fillHistoryPos;
+	for (int i = 0; i < historySize; i++)
+		out << (i ? ", " : "") << fillHistory[(pos + i) % historySize];
+	out << "]\n";
+	out << "}\n";
+}
+
+FileAudioSink::~FileAudioSink() { close(); }
+
+bool FileAudioSink::open(const char *path, int _sampleRate)
+{
+	close();
+
+	file = fopen(path, "wb");
+	if (file == NULL)
+		return false;
+
+	size_t len = strlen(path);
+	wav = len > 4 && (strcmp(path + len - 4, ".wav") == 0 || strcmp(path + len - 4, ".WAV") == 0);
+	sampleRate = _sampleRate;
+	samplesWritten = 0;
+
+	//Written again with the real sizes on close.
+	if (wav)
+		write_wav_header();
+
+	return true;
+}
+
+void FileAudioSink::write_wav_header()
+{
+	uint32_t dataBytes = samplesWritten * sizeof(int16_t);
+	uint32_t byteRate = sampleRate * sizeof(int16_t);
+	uint8_t header[44];
+
+	auto put32 = [&](int at, uint32_t v) {
+		for (int i = 0; i < 4; i++)
+			header[at + i] = (v >> (i * 8)) & 0xff;
+	};
+	auto put16 = [&](int at, uint16_t v) {
+		header[at] = v & 0xff;
+		header[at + 1] = v >> 8;
+	};
+
+	memcpy(header, "RIFF", 4);
+	put32(4, 36 + dataBytes);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	put32(16, 16);               //fmt chunk size
+	put16(20, 1);                //PCM
+	put16(22, 1);                //mono
+	put32(24, sampleRate);
+	put32(28, byteRate);
+	put16(32, sizeof(int16_t));  //block align
+	put16(34, 16);               //bits per sample
+	memcpy(header + 36, "data", 4);
+	put32(40, dataBytes);
+
+	fseek(file, 0, SEEK_SET);
+	fwrite(header, 1, sizeof(header), file);
+	fseek(file, 0, SEEK_END);
+}
+
+void FileAudioSink::close()
+{
+	if (file == NULL)
+		return;
+
+	if (wav)
+		write_wav_header();
+
+	fclose(file);
+	file = NULL;
+}
+
+void FileAudioSink::write(const int16_t *samples, int count)
+{
+	if (file == NULL)
+		return;
+
+	//WAV and the raw output are little-endian, like every platform we build on.
+	fwrite(samples, sizeof(int16_t), count, file);
+	samplesWritten += count;
+}
+
+//Runs on SDL's audio thread. Pulls whatever has been produced and pads with
+//silence if the producer fell behind.
+void SdlAudioSink::play_callback(void *userData, unsigned char *audioData, int length)
+{
+	SdlAudioSink *sink = (SdlAudioSink *)userData;
+	int channels = sink->audioSpec.channels;
+	int frames = length / (sizeof(int16_t) * channels);
+	int16_t *out = (int16_t *)audioData;
+	int available = (int)sink->ring.size();
+
+	if (channels == 1)
+	{
+		int got = (int)sink->ring.read(out, frames);
+		memset(out + got, 0, (frames - got) * sizeof(int16_t));
+		sink->record_callback(available, frames, got);
+		return;
+	}
+	int totalGot = 0;
+
+	//Expand mono to however many channels the device gave us, a chunk at a time.
+	int16_t mono[256];
+	int done = 0;
+	while (done < frames)
+	{
+		int chunk = frames - done < 256 ? frames - done : 256;
+		int got = (int)sink->ring.read(mono, chunk);
+		memset(mono + got, 0, (chunk - got) * sizeof(int16_t));
+		totalGot += got;
+
+		for (int i = 0; i < chunk; i++)
+			for (int c = 0; c < channels; c++)
+				*out++ = mono[i];
+
+		done += chunk;
+	}
+	sink->record_callback(available, frames, totalGot);
+}
+
+//Audio thread. Updates the timing counters after a callback.
+void SdlAudioSink::record_callback(int available, int requested, int got)
+{
+	uint64_t now = SDL_GetPerformanceCounter();
+	uint64_t frequency = SDL_GetPerformanceFrequency();
+	AudioStats &st = audioStats;
+
+	uint64_t count = st.callbacks.fetch_add(1, std::memory_order_relaxed);
+	if (count > 0)
+	{
+		uint32_t interval = (uint32_t)((now - lastCallbackTime) * 1000000 / frequency);
+		float deviation = (float)interval - (float)st.expectedIntervalUs.load(std::memory_order_relaxed);
+		if (deviation < 0)
+			deviation = -deviation;
+
+		st.lastIntervalUs.store(interval, std::memory_order_relaxed);
+		if (interval < st.minIntervalUs.load(std::memory_order_relaxed))
+			st.minIntervalUs.store(interval, std::memory_order_relaxed);
+		if (interval > st.maxIntervalUs.load(std::memory_order_relaxed))
+			st.maxIntervalUs.store(interval, std::memory_order_relaxed);
+
+		float jitter = st.jitterUs.load(std::memory_order_relaxed);
+		st.jitterUs.store(jitter + (deviation - jitter) * 0.05f, std::memory_order_relaxed);
+	}
+	lastCallbackTime = now;
+
+	uint32_t pos = st.fillHistoryPos.load(std::memory_order_relaxed);
+	st.fillHistory[pos].store(available, std::memory_order_relaxed);
+	st.fillHistoryPos.store((pos + 1) % AudioStats::historySize, std::memory_order_relaxed);
+
+	//Running dry only counts as an underrun if something is being produced;
+	//a paused emulator legitimately leaves the ring empty.
+	uint64_t written = samplesWritten.load(std::memory_order_acquire);
+	if (got < requested && written != writtenAtLastCallback)
+	{
+		st.underruns.fetch_add(1, std::memory_order_relaxed);
+		st.underrunSamples.fetch_add(requested - got, std::memory_order_relaxed);
+	}
+	writtenAtLastCallback = written;
+
+	uint64_t readBefore = samplesRead;
+	samplesRead += got;
+
+	if (toneMarked.load(std::memory_order_acquire) && toneMarkSample < samplesRead)
+	{
+		//The marked sample went out 'offset' samples into this callback's buffer.
+		uint64_t offset = toneMarkSample > readBefore ? toneMarkSample - readBefore : 0;
+		uint64_t playedAt = now + offset * frequency / audioSpec.freq;
+		uint32_t delay = playedAt > toneMarkTime ? (uint32_t)((playedAt - toneMarkTime) * 1000000 / frequency) : 0;
+
+		st.tones.fetch_add(1, std::memory_order_relaxed);
+		st.lastToneDelayUs.store(delay, std::memory_order_relaxed);
+		if (delay < st.minToneDelayUs.load(std::memory_order_relaxed))
+			st.minToneDelayUs.store(delay, std::memory_order_relaxed);
+		if (delay > st.maxToneDelayUs.load(std::memory_order_relaxed))
+			st.maxToneDelayUs.store(delay, std::memory_order_relaxed);
+
+		toneMarked.store(false, std::memory_order_release);
+	}
+}
+
+bool SdlAudioSink::open(int sampleRate, int periodSamples, int _maxQueueSamples)
+{
+	SDL_AudioSpec want;
+	SDL_memset(&want, 0, sizeof(want));
+
+	want.freq = sampleRate;
+	want.format = AUDIO_S16LSB;
+	want.channels = 1;
+	want.samples = periodSamples;
+	want.callback = &SdlAudioSink::play_callback;
+	want.userdata = this;
+
+	maxQueueSamples = _maxQueueSamples;
+
+	if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+	{
+		SDL_Log("Failed to initialize audio: %s", SDL_GetError());
+		return false;
+	}
+	subsystemStarted = true;
+
+	//Frequency and format must be exactly what we render; SDL converts if the
+	//hardware differs. Only the channel count may change.
+	deviceID = SDL_OpenAudioDevice(NULL, 0, &want, &audioSpec, SDL_AUDIO_ALLOW_CHANNELS_CHANGE);
+
+	if (deviceID == 0) 
+	{
+		SDL_Log("Failed to open audio: %s", SDL_GetError());
+		return false;
+	}
+
+	audioStats.expectedIntervalUs = (uint32_t)((uint64_t)audioSpec.samples * 1000000 / audioSpec.freq);
+	SDL_PauseAudioDevice(deviceID, 0);
+	return true;
+}
+
+SdlAudioSink::~SdlAudioSink()
+{
+	if (deviceID != 0)
+		SDL_CloseAudioDevice(deviceID);
+
+	if (subsystemStarted)
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+}
+
+void SdlAudioSink::mark_tone_start(int offset, uint64_t hostTime)
+{
+	pendingMark = true;
+	pendingOffset = offset;
+	pendingTime = hostTime;
+}
+
+void SdlAudioSink::write(const int16_t *samples, int count)
+{
+	bool mark = pendingMark;
+	pendingMark = false;
+
+	if ((int)ring.size() + count > maxQueueSamples)
+	{
+		audioStats.overruns.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	uint64_t start = samplesWritten.load(std::memory_order_relaxed);
+
+	//Only one tone is measured at a time; starts that overlap a pending one
+	//are skipped.
+	if (mark && !toneMarked.load(std::memory_order_acquire))
+	{
+		toneMarkSample = start + pendingOffset;
+		toneMarkTime = pendingTime;
+		toneMarked.store(true, std::memory_order_release);
+	}
+
+	size_t accepted = ring.write(samples, count);
+	samplesWritten.store(start + accepted, std::memory_order_release);
+}
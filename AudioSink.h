@@ -0,0 +1,157 @@
+/** Destinations for the rendered chip8 sound. Samples are **/
+/** always 16-bit signed mono at the rate the sink was     **/
+/** opened with, and are written from the thread that      **/
+/** renders the tone timeline.                             **/
+
+#pragma once
+#include<SDL.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+#include "SpscRing.h"
+
+///Timing and health counters for a real-time sink. Written by the producer
+///and the audio thread, read from anywhere.
+struct AudioStats
+{
+	static constexpr int historySize = 128;
+
+	std::atomic<uint64_t> callbacks{0};
+
+	///Time between callbacks in microseconds: the expected period, the last,
+	///the extremes, and a running average of the deviation from expected.
+	std::atomic<uint32_t> expectedIntervalUs{0};
+	std::atomic<uint32_t> lastIntervalUs{0};
+	std::atomic<uint32_t> minIntervalUs{UINT32_MAX};
+	std::atomic<uint32_t> maxIntervalUs{0};
+	std::atomic<float> jitterUs{0.0f};
+
+	///Callbacks that found fewer samples than asked for while sound was being
+	///produced, and the total samples padded with silence because of it.
+	std::atomic<uint64_t> underruns{0};
+	std::atomic<uint64_t> underrunSamples{0};
+
+	///Blocks dropped because the ring was already over its limit.
+	std::atomic<uint64_t> overruns{0};
+
+	///Samples in the ring at each of the last historySize callbacks.
+	std::atomic<int32_t> fillHistory[historySize];
+	std::atomic<uint32_t> fillHistoryPos{0};
+
+	///Delay from ST going non-zero to its first sample reaching the device, in
+	///microseconds, for the last tone and the extremes over all tones.
+	std::atomic<uint64_t> tones{0};
+	std::atomic<uint32_t> lastToneDelayUs{0};
+	std::atomic<uint32_t> minToneDelayUs{UINT32_MAX};
+	std::atomic<uint32_t> maxToneDelayUs{0};
+
+	AudioStats()
+	{
+		for (int i = 0; i < historySize; i++)
+			fillHistory[i] = 0;
+	}
+
+	void write_json(std::ostream &out) const;
+};
+
+class AudioSink
+{
+public:
+	virtual ~AudioSink() {}
+
+	virtual void write(const int16_t *samples, int count) = 0;
+
+	///Samples written but not yet played, or -1 for sinks that consume
+	///instantly and so have no clock of their own.
+	virtual int queued() const { return -1; }
+
+	///Marks the sample at 'offset' into the next write() as the start of a
+	///tone that began at hostTime (SDL performance counter), so the sink can
+	///measure how long it took to be heard.
+	virtual void mark_tone_start(int /*offset*/, uint64_t /*hostTime*/) {}
+
+	///Timing counters, or NULL for sinks that don't play in real time.
+	virtual const AudioStats *stats() const { return NULL; }
+};
+
+///Discards everything. Used for benchmarks and when no device is available.
+class NullAudioSink : public AudioSink
+{
+public:
+	void write(const int16_t *, int) override {}
+};
+
+///Writes to a WAV or headerless raw PCM file, as fast as it's fed.
+class FileAudioSink : public AudioSink
+{
+private:
+	FILE *file = NULL;
+	bool wav = false;
+	int sampleRate = 0;
+	uint32_t samplesWritten = 0;
+
+	void write_wav_header();
+
+public:
+	~FileAudioSink();
+
+	///Files ending in .wav get a WAV header, anything else is raw PCM.
+	bool open(const char *path, int _sampleRate);
+	void close();
+
+	void write(const int16_t *samples, int count) override;
+};
+
+///Streams to an SDL audio device. Samples go into a lock-free ring that the
+///device callback pulls from on SDL's audio thread. The SDL audio subsystem
+///is only started here, so the other sinks never touch the audio driver.
+class SdlAudioSink : public AudioSink
+{
+private:
+	SpscRing<int16_t> ring;
+	SDL_AudioSpec audioSpec;
+	SDL_AudioDeviceID deviceID = 0;
+	bool subsystemStarted = false;
+
+	//Blocks are dropped rather than queued beyond this, so latency stays bounded.
+	int maxQueueSamples = 0;
+
+	AudioStats audioStats;
+
+	//Total samples accepted by write(), published for the callback.
+	std::atomic<uint64_t> samplesWritten{0};
+
+	//Audio thread only.
+	uint64_t samplesRead = 0;
+	uint64_t lastCallbackTime = 0;
+	uint64_t writtenAtLastCallback = 0;
+
+	//A tone start waiting for the callback to reach it. The producer only
+	//sets one while toneMarked is clear, and the callback clears it.
+	std::atomic<bool> toneMarked{false};
+	uint64_t toneMarkSample = 0;
+	uint64_t toneMarkTime = 0;
+
+	//Producer only: a mark for the next write().
+	bool pendingMark = false;
+	int pendingOffset = 0;
+	uint64_t pendingTime = 0;
+
+	void record_callback(int available, int requested, int got);
+
+	static void play_callback(void *userData, unsigned char *audioData, int length);
+
+public:
+	explicit SdlAudioSink(int capacity) : ring(capacity) {}
+	~SdlAudioSink();
+
+	bool open(int sampleRate, int periodSamples, int _maxQueueSamples);
+
+	void write(const int16_t *samples, int count) override;
+	int queued() const override { return (int)ring.size(); }
+	void mark_tone_start(int offset, uint64_t hostTime) override;
+	const AudioStats *stats() const override { return &audioStats; }
+};
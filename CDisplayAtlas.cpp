@@ -0,0 +1,82 @@
+#include "CDisplayAtlas.h"
+#include <cmath>
+#include <cstring>
+
+CDisplayAtlas::CDisplayAtlas()
+	: tileWidth(0), tileHeight(0), tiles(0), columns(0), width(0), height(0), dirtyFirst(0), dirtyLast(-1)
+{
+}
+
+void CDisplayAtlas::free_texture()
+{
+	texture.free_texture();
+	pixels.clear();
+	tiles = 0;
+}
+
+bool CDisplayAtlas::init(int count, int _tileWidth, int _tileHeight, DisplayBackend backend)
+{
+	tileWidth = _tileWidth;
+	tileHeight = _tileHeight;
+	tiles = count;
+
+	//Roughly square, which keeps both sides well inside texture size limits.
+	columns = (int)std::ceil(std::sqrt((double)(count > 0 ? count : 1)));
+	int tileRows = (count + columns - 1) / columns;
+	if (tileRows < 1)
+		tileRows = 1;
+
+	width = columns * tileWidth;
+	height = tileRows * tileHeight;
+	pixels.assign(width * height, 0);
+
+	dirtyFirst = 0;
+	dirtyLast = -1;
+	return texture.init(pixels.data(), width, height, backend);
+}
+
+void CDisplayAtlas::set_tile(int tile, const uint8_t* tilePixels, int firstRow, int rows)
+{
+	if (tile < 0 || tile >= tiles || rows <= 0)
+		return;
+
+	int x = (tile % columns) * tileWidth;
+	int y = (tile / columns) * tileHeight + firstRow;
+
+	for (int row = 0; row < rows; row++)
+		memcpy(&pixels[(y + row) * width + x], tilePixels + (firstRow + row) * tileWidth, tileWidth);
+
+	if (dirtyLast < dirtyFirst)
+	{
+		dirtyFirst = y;
+		dirtyLast = y + rows - 1;
+	}
+	else
+	{
+		if (y < dirtyFirst)
+			dirtyFirst = y;
+		if (y + rows - 1 > dirtyLast)
+			dirtyLast = y + rows - 1;
+	}
+}
+
+bool CDisplayAtlas::upload()
+{
+	if (dirtyLast < dirtyFirst)
+		return true;
+
+	bool ok = texture.update(pixels.data(), dirtyFirst, dirtyLast - dirtyFirst + 1);
+	dirtyFirst = 0;
+	dirtyLast = -1;
+	return ok;
+}
+
+void CDisplayAtlas::draw_tile(int tile, const ImVec2& size)
+{
+	if (tile < 0 || tile >= tiles)
+		return;
+
+	float x = (float)((tile % columns) * tileWidth);
+	float y = (float)((tile / columns) * tileHeight);
+	texture.draw(size, ImVec2(x / width, y / height), ImVec2((x + tileWidth) / width, (y + tileHeight) / height));
+}
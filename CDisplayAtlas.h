@@ -0,0 +1,47 @@
+/** Packs many equally sized display images into one texture **/
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "CDisplayTexture.h"
+
+//Tiles are laid out in rows, left to right. Changed rows of each tile are
+//copied into a CPU side image as they arrive, and upload() then sends every
+//change made since the last upload in one go.
+class CDisplayAtlas
+{
+private:
+	CDisplayTexture texture;
+
+	int tileWidth;
+	int tileHeight;
+	int tiles;
+	int columns;
+	int width;
+	int height;
+	std::vector<uint8_t> pixels;
+
+	//Span of atlas rows changed since the last upload. Empty when dirtyLast < dirtyFirst.
+	int dirtyFirst;
+	int dirtyLast;
+
+public:
+	CDisplayAtlas();
+	void free_texture();
+
+	//Makes room for 'count' tiles, all blank. Any old contents are dropped.
+	bool init(int count, int _tileWidth, int _tileHeight, DisplayBackend backend);
+
+	int tile_count() const { return tiles; }
+
+	//Copies rows [firstRow, firstRow + rows) of a full tile image into a tile.
+	void set_tile(int tile, const uint8_t* tilePixels, int firstRow, int rows);
+
+	//Sends all the tile changes since the last call to the texture.
+	bool upload();
+
+	void set_palette(const DisplayPalette& colours) { texture.set_palette(colours); }
+
+	//Adds one tile to the current ImGui window.
+	void draw_tile(int tile, const ImVec2& size);
+};
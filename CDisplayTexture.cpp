@@ -0,0 +1,243 @@
+#include "CDisplayTexture.h"
+#include "GLFunctions.h"
+#include "imgui/imgui_impl_opengl3.h"
+#include <cstring>
+#include <iostream>
+
+const DisplayPalette CDisplayTexture::palettes[] = {
+	{"Grey", 2, {0xc8c8c8, 0x0a0a0a}},
+	{"Amber", 2, {0x1c1000, 0xffb000}},
+	{"Green", 2, {0x0a1a0a, 0x33ff66}},
+	{"Octo", 4, {0x996600, 0xffcc00, 0xff6600, 0x662200}},
+	{"Grey 4", 4, {0xc8c8c8, 0x0a0a0a, 0x787878, 0x3c3c3c}},
+};
+
+const int CDisplayTexture::paletteCount = sizeof(palettes) / sizeof(palettes[0]);
+
+//GLSL 1.10 so it runs on any GL 2 driver, including Mesa's llvmpipe. The
+//vertex stage is left to the fixed function pipeline ImGui draws with.
+static const char* paletteFragmentShader =
+	"#version 110\n"
+	"uniform sampler2D indices;\n"
+	"uniform sampler2D palette;\n"
+	"void main()\n"
+	"{\n"
+	"	float index = floor(texture2D(indices, gl_TexCoord[0].st).r * 255.0 + 0.5);\n"
+	"	gl_FragColor = texture2D(palette, vec2((index + 0.5) / 16.0, 0.5));\n"
+	"}\n";
+
+CDisplayTexture::CDisplayTexture()
+	: backend(BACKEND_GL2), paletteTexID(0), program(0), width(0), height(0), current(palettes[0]), indices(NULL), coloured(NULL)
+{
+	memset(palette, 0, sizeof(palette));
+}
+
+CDisplayTexture::~CDisplayTexture()
+{
+	free_texture();
+}
+
+void CDisplayTexture::free_texture()
+{
+	texture.free_texture();
+
+	if (paletteTexID != 0)
+	{
+		glDeleteTextures(1, &paletteTexID);
+		paletteTexID = 0;
+	}
+
+	if (program != 0)
+	{
+		gl::DeleteProgram(program);
+		program = 0;
+	}
+
+	delete[] indices;
+	delete[] coloured;
+	indices = NULL;
+	coloured = NULL;
+}
+
+bool CDisplayTexture::init(const uint8_t* pixels, int _width, int _height, DisplayBackend _backend)
+{
+	free_texture();
+
+	width = _width;
+	height = _height;
+	backend = _backend;
+
+	if (backend == BACKEND_SOFTWARE)
+	{
+		indices = new uint8_t[width * height];
+		memcpy(indices, pixels, width * height);
+
+		softTexture.format = SoftTexture::INDEXED8;
+		softTexture.width = width;
+		softTexture.height = height;
+		softTexture.pixels = indices;
+		softTexture.palette = softPalette;
+
+		set_palette(current);
+		return true;
+	}
+
+	if (backend == BACKEND_GL2)
+	{
+		program = gl::build_program(NULL, paletteFragmentShader);
+		if (program != 0)
+		{
+			//The samplers always read from the same units.
+			gl::UseProgram(program);
+			gl::Uniform1i(gl::GetUniformLocation(program, "indices"), 0);
+			gl::Uniform1i(gl::GetUniformLocation(program, "palette"), 1);
+			gl::UseProgram(0);
+		}
+	}
+
+	if (backend == BACKEND_GL3 || program != 0)
+	{
+		glGenTextures(1, &paletteTexID);
+		glBindTexture(GL_TEXTURE_2D, paletteTexID);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, paletteSize, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		set_palette(current);
+		return texture.init(pixels, width, height, backend == BACKEND_GL3 ? GL_RED : GL_LUMINANCE);
+	}
+
+	std::cout << "Palette shader unavailable, colouring the display on the CPU." << std::endl;
+
+	indices = new uint8_t[width * height];
+	coloured = new GLubyte[width * height * 4];
+	memcpy(indices, pixels, width * height);
+
+	set_palette(current);
+	colour_rows(0, height);
+	return texture.init(coloured, width, height, GL_RGBA);
+}
+
+bool CDisplayTexture::update(const uint8_t* pixels, int firstRow, int rows)
+{
+	if (paletteTexID != 0)
+		return texture.update(pixels, firstRow, rows);
+
+	memcpy(indices + firstRow * width, pixels + firstRow * width, rows * width);
+	if (backend == BACKEND_SOFTWARE)
+		return true;
+
+	colour_rows(firstRow, rows);
+	return texture.update(coloured, firstRow, rows);
+}
+
+void CDisplayTexture::colour_rows(int firstRow, int rows)
+{
+	const uint8_t* in = indices + firstRow * width;
+	GLubyte* out = coloured + firstRow * width * 4;
+
+	for (int i = 0; i < rows * width; i++)
+		memcpy(out + i * 4, palette + (in[i] % paletteSize) * 4, 4);
+}
+
+DisplayPalette CDisplayTexture::ramp(const DisplayPalette& base)
+{
+	DisplayPalette steps;
+	steps.name = base.name;
+	steps.count = paletteSize;
+
+	uint32_t from = base.colours[0];
+	uint32_t to = base.colours[base.count > 1 ? 1 : 0];
+	for (int i = 0; i < paletteSize; i++)
+	{
+		uint32_t rgb = 0;
+		for (int shift = 0; shift <= 16; shift += 8)
+		{
+			int a = (from >> shift) & 0xff;
+			int b = (to >> shift) & 0xff;
+			rgb |= (uint32_t)(a + (b - a) * i / (paletteSize - 1)) << shift;
+		}
+		steps.colours[i] = rgb;
+	}
+
+	return steps;
+}
+
+void CDisplayTexture::set_palette(const DisplayPalette& colours)
+{
+	current = colours;
+
+	//Indices past the end of a short palette repeat it.
+	for (int i = 0; i < paletteSize; i++)
+	{
+		uint32_t rgb = colours.colours[i % colours.count];
+		palette[i * 4 + 0] = (rgb >> 16) & 0xff;
+		palette[i * 4 + 1] = (rgb >> 8) & 0xff;
+		palette[i * 4 + 2] = rgb & 0xff;
+		palette[i * 4 + 3] = 0xff;
+		softPalette[i] = IM_COL32(palette[i * 4 + 0], palette[i * 4 + 1], palette[i * 4 + 2], 0xff);
+	}
+
+	if (backend == BACKEND_SOFTWARE)
+		return;
+
+	if (paletteTexID != 0)
+	{
+		glBindTexture(GL_TEXTURE_2D, paletteTexID);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, paletteSize, 1, GL_RGBA, GL_UNSIGNED_BYTE, palette);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	else if (indices != NULL)
+	{
+		colour_rows(0, height);
+		texture.update(coloured);
+	}
+}
+
+void CDisplayTexture::begin_palette(const ImDrawList*, const ImDrawCmd* cmd)
+{
+	CDisplayTexture* display = (CDisplayTexture*)cmd->UserCallbackData;
+
+	if (display->backend == BACKEND_GL3)
+	{
+		ImGui_ImplOpenGL3_SetPalette(display->paletteTexID);
+		return;
+	}
+
+	gl::UseProgram(display->program);
+	gl::ActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, display->paletteTexID);
+	gl::ActiveTexture(GL_TEXTURE0);
+}
+
+void CDisplayTexture::end_palette(const ImDrawList*, const ImDrawCmd* cmd)
+{
+	CDisplayTexture* display = (CDisplayTexture*)cmd->UserCallbackData;
+
+	if (display->backend == BACKEND_GL3)
+		ImGui_ImplOpenGL3_SetPalette(0);
+	else
+		gl::UseProgram(0);
+}
+
+void CDisplayTexture::draw(const ImVec2& size, const ImVec2& uv0, const ImVec2& uv1)
+{
+	if (backend == BACKEND_SOFTWARE)
+	{
+		ImGui::Image((void*)&softTexture, size, uv0, uv1);
+		return;
+	}
+
+	ImDrawList* list = ImGui::GetWindowDrawList();
+
+	if (paletteTexID != 0)
+		list->AddCallback(begin_palette, this);
+
+	ImGui::Image((void*)(intptr_t)texture.get_texture_id(), size, uv0, uv1);
+
+	if (paletteTexID != 0)
+		list->AddCallback(end_palette, this);
+}
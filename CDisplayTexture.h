@@ -0,0 +1,88 @@
+/** Shows palette indexed display images, colouring them on the GPU when it can **/
+
+#pragma once
+#include <cstdint>
+#include "CTexture.h"
+#include "imgui/imgui.h"
+#include "imgui/imgui_impl_soft.h"
+
+//The ImGui renderer the display is drawn through.
+enum DisplayBackend
+{
+	BACKEND_GL2,
+	BACKEND_GL3,
+	BACKEND_SOFTWARE
+};
+
+//A named set of display colours, as 0xRRGGBB. Entry n colours pixels of index n.
+struct DisplayPalette
+{
+	const char* name;
+	int count;
+	uint32_t colours[16];
+};
+
+class CDisplayTexture
+{
+private:
+	static const int paletteSize = 16;
+
+	//Holds the indices when a palette shader is available, otherwise the
+	//image already coloured on the CPU.
+	CTexture texture;
+
+	DisplayBackend backend;
+
+	//16x1 RGBA lookup texture. On GL2 the display also needs its own program to
+	//read through it; the GL3 renderer's shader can do the lookup itself.
+	GLuint paletteTexID;
+	GLuint program;
+
+	int width;
+	int height;
+	GLubyte palette[paletteSize * 4];
+
+	//Kept so the colours survive init() when the display changes size.
+	DisplayPalette current;
+
+	//Without a shader the last image is kept so a palette change can recolour it.
+	//The software renderer reads the indices straight from here.
+	uint8_t* indices;
+	GLubyte* coloured;
+
+	//What the software renderer draws, with the palette packed like IM_COL32().
+	SoftTexture softTexture;
+	uint32_t softPalette[paletteSize];
+
+	void colour_rows(int firstRow, int rows);
+
+	//ImGui draw callbacks that switch the palette program on and off around the image.
+	static void begin_palette(const ImDrawList* list, const ImDrawCmd* cmd);
+	static void end_palette(const ImDrawList* list, const ImDrawCmd* cmd);
+
+public:
+	//The built in palettes. The first one matches the original grey display.
+	static const DisplayPalette palettes[];
+	static const int paletteCount;
+
+	//A ramp of 16 colours from the first colour of 'base' to its second, for
+	//showing brightness levels such as phosphor glow.
+	static DisplayPalette ramp(const DisplayPalette& base);
+
+	CDisplayTexture();
+	~CDisplayTexture();
+	void free_texture();
+
+	bool init(const uint8_t* pixels, int _width, int _height, DisplayBackend _backend);
+
+	//Uploads rows [firstRow, firstRow + rows) of a full size index image.
+	bool update(const uint8_t* pixels, int firstRow, int rows);
+
+	void set_palette(const DisplayPalette& colours);
+
+	//Whether colours are applied by a shader rather than on the CPU.
+	bool shaded() const { return paletteTexID != 0; }
+
+	//Adds the display, or the part of it between uv0 and uv1, to the current ImGui window.
+	void draw(const ImVec2& size, const ImVec2& uv0 = ImVec2(0, 0), const ImVec2& uv1 = ImVec2(1, 1));
+};
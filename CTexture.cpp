@@ -1,7 +1,32 @@
 #include "CTexture.h"
+#include "GLFunctions.h"
+#include <cstring>
 #include <iostream>
 
-CTexture::CTexture() {}
+//glGetError waits for the GL to catch up, so per frame checks are only done
+//in debug builds.
+#ifdef NDEBUG
+#define CHECK_GL_ERROR(what) true
+#else
+#define CHECK_GL_ERROR(what) check_gl_error(what)
+#endif
+
+static bool check_gl_error(const char* what)
+{
+	GLenum error = glGetError();
+	if (error != GL_NO_ERROR)
+	{
+		std::cout << "Error " << what << " texture: " << error << std::endl;
+		return false;
+	}
+	return true;
+}
+
+CTexture::CTexture()
+	: texID(0), width(0), height(0), format(GL_RGBA), bytesPerPixel(4), uploadBufferCount(0),
+	  nextUploadBuffer(0)
+{
+}
 
 CTexture::~CTexture()
 {
@@ -10,29 +35,38 @@ CTexture::~CTexture()
 
 void CTexture::free_texture()
 {
-	glBindTexture(GL_TEXTURE_2D, 0);
-
 	//Delete texture
 	if (texID != 0)
 	{
+		glBindTexture(GL_TEXTURE_2D, 0);
 		glDeleteTextures(1, &texID);
 		texID = 0;
 	}
 
+	if (uploadBufferCount > 0)
+	{
+		gl::DeleteBuffers(uploadBufferCount, uploadBuffers);
+		uploadBufferCount = 0;
+	}
+
 	width = 0;
 	height = 0;
 }
 
-bool CTexture::init(GLuint* pixels, GLfloat _width, GLfloat _height)
+bool CTexture::init(const void* pixels, GLfloat _width, GLfloat _height, GLenum _format,
+	bool streaming)
 {
-	glEnable(GL_TEXTURE_2D);
-
 	//Free texture if it exists
 	free_texture();
 
 	//Get texture dimensions
 	width = _width;
 	height = _height;
+	format = _format;
+	bytesPerPixel = format == GL_RGBA ? 4 : 1;
+
+	//Rows of single byte textures needn't be a multiple of 4 bytes long.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	
 	//Generate texture ID
 	glGenTextures(1, &texID);
@@ -41,7 +75,10 @@ bool CTexture::init(GLuint* pixels, GLfloat _width, GLfloat _height)
 	glBindTexture(GL_TEXTURE_2D, texID);
 	
 	//Generate texture
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	//Core profile contexts have no luminance formats, so single byte images use
+	//the red channel there.
+	GLint internalFormat = format == GL_RED ? GL_R8 : format;
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
 	
 	//Set texture parameters
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -50,59 +87,71 @@ bool CTexture::init(GLuint* pixels, GLfloat _width, GLfloat _height)
 	//Unbind texture
 	glBindTexture(GL_TEXTURE_2D, 0);
 
-	//Check for error
-	GLenum error = glGetError();
-	if (error != GL_NO_ERROR)
+	//Storage for the buffers is (re)allocated on every upload, so only the
+	//names are created here.
+	if (streaming && gl::has_buffers())
 	{
-		std::cout << "Error init texture: " << error;
-		return false;
+		gl::GenBuffers(maxUploadBuffers, uploadBuffers);
+		uploadBufferCount = maxUploadBuffers;
+		nextUploadBuffer = 0;
 	}
 
-	return true;
+	//Check for error
+	return check_gl_error("init");
+}
+
+bool CTexture::update(const void* pixels)
+{
+	return update(pixels, 0, (int)height);
 }
 
-bool CTexture::update(GLuint* pixels)
+bool CTexture::update(const void* pixels, int firstRow, int rows)
 {
+	if (rows <= 0)
+		return true;
+
+	const GLubyte* first = (const GLubyte*)pixels + firstRow * (int)width * bytesPerPixel;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
 	//Bind texture ID
 	glBindTexture(GL_TEXTURE_2D, texID);
 
-	//Generate texture
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	if (uploadBufferCount == 0 || !upload_streaming(first, firstRow, rows))
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, width, rows, format, GL_UNSIGNED_BYTE, first);
 
 	glBindTexture(GL_TEXTURE_2D, 0);
 
 	//Check for error
-	GLenum error = glGetError();
-	if (error != GL_NO_ERROR)
-	{
-		std::cout << "Error init texture: " << error;
-		return false;
-	}
-	return true;
+	return CHECK_GL_ERROR("update");
 }
 
-void CTexture::render(GLfloat x, GLfloat y)
+bool CTexture::upload_streaming(const GLubyte* pixels, int firstRow, int rows)
 {
-	//If the texture exists
-	if (texID != 0)
+	GLuint buffer = uploadBuffers[nextUploadBuffer];
+	nextUploadBuffer = (nextUploadBuffer + 1) % uploadBufferCount;
+
+	int rowBytes = (int)width * bytesPerPixel;
+	gl::BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+
+	//Dropping the old storage first lets the driver hand back fresh memory
+	//rather than wait for a copy still reading from this buffer.
+	gl::BufferData(GL_PIXEL_UNPACK_BUFFER, rowBytes * rows, NULL, GL_STREAM_DRAW);
+	void* mapped = gl::MapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+	if (mapped == NULL)
 	{
-		glMatrixMode(GL_MODELVIEW);
-		glLoadIdentity();
-
-		//Move to rendering point
-		glTranslatef(x, y, 0.f);
-
-		//Set texture ID
-		glBindTexture(GL_TEXTURE_2D, texID);
-
-		//Render textured quad
-		glBegin(GL_QUADS);
-			glTexCoord2f(0.f, 0.f); glVertex2f(0.f, 0.f);
-			glTexCoord2f(1.f, 0.f); glVertex2f(width, 0.f);
-			glTexCoord2f(1.f, 1.f); glVertex2f(width, height);
-			glTexCoord2f(0.f, 1.f); glVertex2f(0.f, height);
-		glEnd();
+		gl::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return false;
 	}
+
+	memcpy(mapped, pixels, rowBytes * rows);
+	gl::UnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	//With a buffer bound the last argument is an offset into it, and the call
+	//returns without waiting for the copy.
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, width, rows, format, GL_UNSIGNED_BYTE, NULL);
+
+	gl::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return true;
 }
 
 GLuint  CTexture::get_texture_id() { return texID; }
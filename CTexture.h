@@ -6,17 +6,41 @@
 class CTexture
 {
 private:
+	//Number of pixel buffers cycled through when streaming.
+	static const int maxUploadBuffers = 3;
+
 	GLuint  texID;
 	GLfloat  width;
 	GLfloat  height;
 
+	//GL_RGBA, or GL_LUMINANCE or GL_RED for one byte per pixel.
+	GLenum format;
+	int bytesPerPixel;
+
+	//Pixel buffer objects for streaming uploads. The CPU fills one while the
+	//GPU may still be copying out of the others. Empty when streaming isn't
+	//used or the driver doesn't support it.
+	GLuint uploadBuffers[maxUploadBuffers];
+	int uploadBufferCount;
+	int nextUploadBuffer;
+
+	bool upload_streaming(const GLubyte* pixels, int firstRow, int rows);
+
 public:
 	CTexture();
 	~CTexture();
 	void free_texture();
-	bool init(GLuint* pixels, GLfloat _width, GLfloat _height);
-	bool update(GLuint* pixels);
-	void render(GLfloat x, GLfloat y);
+
+	//Creates the texture from RGBA or single byte (GL_LUMINANCE/GL_RED) pixels. With
+	//streaming set, later updates go through a ring of pixel buffer objects
+	//instead of blocking the caller until GL has copied the pixels.
+	bool init(const void* pixels, GLfloat _width, GLfloat _height, GLenum _format = GL_RGBA,
+		bool streaming = true);
+
+	bool update(const void* pixels);
+
+	//Uploads only rows [firstRow, firstRow + rows) of a full size pixel image.
+	bool update(const void* pixels, int firstRow, int rows);
+
 	GLuint get_texture_id();
 };
-
@@ -1,5 +1,6 @@
-#include "chip8.h"
+#include "Chip8.h"
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <iostream>
 
@@ -14,6 +15,10 @@ Chip8::Chip8()
   {
     Memory[i] = 0;
   }
+
+  //The display is allocated once so its address never changes under a reader.
+  display = new uint8_t[64 * 32];
+  DT = ST = 0;
 }
 
 Chip8::~Chip8() { delete[] display; }
@@ -25,11 +30,17 @@ void Chip8::boot(char program[], int32_t len)
     Memory[ROMTOP + i] = program[i];
   }
 
-  keyPressed = 0xff;
+  keys = 0;
+  keyWaiting = -1;
   SP = 0;
   I = 0;
   PC = ROMTOP;
+
+  if (ST > 0)
+    emit_tone(false);
   DT = ST = 0;
+  cycles = 0;
+  CHIP8_STAT(stats.reset());
 
   for (int32_t i = 0; i < 16; i++)
   {
@@ -38,20 +49,134 @@ void Chip8::boot(char program[], int32_t len)
   }
 
   srand((int32_t)time(0));
-  display = new uint32_t[64 * 32];
 
   for (int32_t i = 0; i < 64 * 32; i++)
   {
     display[i] = PIXEL_OFF;
   }
+  for (int32_t i = 0; i < 32; i++)
+    rowSeq[i] = frameSeq + 1;
+  publish_frame();
 
   std::cout << "Chip 8 initialized\n";
 }
 
+void Chip8::save_state(Chip8Snapshot &snapshot) const
+{
+  memcpy(snapshot.memory, Memory, sizeof(snapshot.memory));
+  memcpy(snapshot.display, display, sizeof(snapshot.display));
+  memcpy(snapshot.V, V, sizeof(snapshot.V));
+  memcpy(snapshot.stack, Stack, sizeof(snapshot.stack));
+  snapshot.SP = SP;
+  snapshot.I = I;
+  snapshot.PC = PC;
+  snapshot.DT = DT;
+  snapshot.ST = ST;
+  snapshot.cycles = cycles;
+  snapshot.shiftUsingVY = shiftUsingVY;
+  snapshot.incrementIOnLD = incrementIOnLD;
+}
+
+void Chip8::load_state(const Chip8Snapshot &snapshot)
+{
+  if ((ST > 0) != (snapshot.ST > 0))
+    emit_tone(snapshot.ST > 0);
+
+  memcpy(Memory, snapshot.memory, sizeof(Memory));
+  memcpy(display, snapshot.display, 64 * 32);
+  memcpy(V, snapshot.V, sizeof(V));
+  memcpy(Stack, snapshot.stack, sizeof(Stack));
+  SP = snapshot.SP;
+  I = snapshot.I;
+  PC = snapshot.PC;
+  DT = snapshot.DT;
+  ST = snapshot.ST;
+  cycles = snapshot.cycles;
+  shiftUsingVY = snapshot.shiftUsingVY;
+  incrementIOnLD = snapshot.incrementIOnLD;
+
+  //The keys held now may not be the ones held when it was saved, so a key
+  //wait starts over.
+  keyWaiting = -1;
+
+  for (int32_t i = 0; i < 32; i++)
+    rowSeq[i] = frameSeq + 1;
+  publish_frame();
+}
+
+void Chip8::publish_frame()
+{
+  Chip8Frame &frame = frames.back();
+  memcpy(frame.pixels, display, sizeof(frame.pixels));
+  memcpy(frame.rowSeq, rowSeq, sizeof(frame.rowSeq));
+  frame.glowing = phosphor.enabled();
+  if (frame.glowing)
+    phosphor.light(display, frame.glow);
+  frame.cycle = cycles;
+  frame.seq = ++frameSeq;
+  frames.publish();
+}
+
+void Chip8::emit_tone(bool on)
+{
+  ToneEvent event;
+  event.tick = timerTicks;
+  event.cycle = tickCycle;
+  event.cyclesPerTick = cyclesPerTick;
+  event.on = on;
+  toneEvents.push(event);
+}
+
+void Chip8::tick_timers()
+{
+  timerTicks++;
+  sharedTimerTicks.store(timerTicks, std::memory_order_relaxed);
+  tickCycle = 0;
+
+  if (DT > 0)
+    DT--;
+
+  if (ST > 0)
+  {
+    ST--;
+    //The tone stops exactly on the tick boundary.
+    if (ST == 0)
+      emit_tone(false);
+  }
+
+  //Fading pixels change the picture without any DRW, so those changes are
+  //published here, at most once a frame.
+  uint32_t fadedRows = phosphor.fade(display);
+  if (fadedRows != 0)
+  {
+    for (int32_t row = 0; row < 32; row++)
+      if (fadedRows & (1u << row))
+        rowSeq[row] = frameSeq + 1;
+    publish_frame();
+  }
+}
+
+bool Chip8::idle() const
+{
+  if (DT > 0 || ST > 0 || phosphor.fading())
+    return false;
+
+  uint16_t opcode = (Memory[PC] << 8) | Memory[PC + 1];
+  if ((opcode & 0xf0ff) != 0xf00a)
+    return false;
+
+  //Fx0A repeats until a key goes down and then up again.
+  return keyWaiting < 0 ? keys == 0 : (keys & (1 << keyWaiting)) != 0;
+}
+
 void Chip8::step()
 {
   int16_t opcode = (Memory[PC] << 8) | Memory[PC + 1]; // Big-endian order
+  CHIP8_STAT(stats.reset_if_requested());
+  CHIP8_STAT(stats.instructions++);
+  CHIP8_STAT(stats.pcCount[PC & 0xfff]++);
   PC += 2;
+  cycles++;
   // display[rand() % 200] = rand() % 16384;
   // cache common operations
   int16_t nnn = mask_nnn(opcode);
@@ -69,19 +194,25 @@ void Chip8::step()
       {
         case 0x00E0: // CLS
         {
+          CHIP8_STAT(stats.opClass[OPC_CLS]++);
           // clear display
           for (int32_t i = 0; i < 64 * 32; i++)
             display[i] = PIXEL_OFF;
+          for (int32_t i = 0; i < 32; i++)
+            rowSeq[i] = frameSeq + 1;
+          publish_frame();
           break;
         }
         case 0x00EE: // RET
         {
+          CHIP8_STAT(stats.opClass[OPC_RET]++);
           PC = Stack[SP];
           SP--;
           break;
         }
         default:
         {
+          CHIP8_STAT(stats.opClass[OPC_SYS]++);
           //std::cout << "Unknown instruction:" << opcode;
           break;
         }
@@ -90,11 +221,13 @@ void Chip8::step()
     }
     case 0x1: // JP addr
     {
+      CHIP8_STAT(stats.opClass[OPC_JP]++);
       PC = nnn;
       break;
     }
     case 0x2: // Call addr
     {
+      CHIP8_STAT(stats.opClass[OPC_CALL]++);
       SP++;
       Stack[SP] = PC;
       PC = nnn;
@@ -102,35 +235,55 @@ void Chip8::step()
     }
     case 0x3: // SE Vx, byte
     {
+      CHIP8_STAT(stats.opClass[OPC_SE_BYTE]++);
+      CHIP8_STAT(stats.skipsTested++);
       if (V[x] == kk)
+      {
+        CHIP8_STAT(stats.skipsTaken++);
         PC += 2;
+      }
 
       break;
     }
     case 0x4: // SNE Vx, byte
     {
+      CHIP8_STAT(stats.opClass[OPC_SNE_BYTE]++);
+      CHIP8_STAT(stats.skipsTested++);
       if (V[x] != kk)
+      {
+        CHIP8_STAT(stats.skipsTaken++);
         PC += 2;
+      }
 
       break;
     }
     case 0x5: // SE Vx, Vy
     {
       if (n != 0)
+      {
+        CHIP8_STAT(stats.opClass[OPC_UNKNOWN]++);
         break;
+      }
 
+      CHIP8_STAT(stats.opClass[OPC_SE_REG]++);
+      CHIP8_STAT(stats.skipsTested++);
       if (V[x] == V[y])
+      {
+        CHIP8_STAT(stats.skipsTaken++);
         PC += 2;
+      }
 
       break;
     }
     case 0x6: // LD Vx, byte
     {
+      CHIP8_STAT(stats.opClass[OPC_LD_BYTE]++);
       V[x] = kk;
       break;
     }
     case 0x7: // ADD Vx, byte
     {
+      CHIP8_STAT(stats.opClass[OPC_ADD_BYTE]++);
       V[x] += kk;
       break;
     }
@@ -140,26 +293,31 @@ void Chip8::step()
       {
         case 0x0: // LD Vx, Vy
         {
+          CHIP8_STAT(stats.opClass[OPC_LD_REG]++);
           V[x] = V[y];
           break;
         }
         case 0x1: // OR Vx, Vy
         {
+          CHIP8_STAT(stats.opClass[OPC_OR]++);
           V[x] |= V[y];
           break;
         }
         case 0x2: // AND Vx, Vy
         {
+          CHIP8_STAT(stats.opClass[OPC_AND]++);
           V[x] &= V[y];
           break;
         }
         case 0x3: // XOR Vx, Vy
         {
+          CHIP8_STAT(stats.opClass[OPC_XOR]++);
           V[x] ^= V[y];
           break;
         }
         case 0x4: // ADD Vx, Vy
         {
+          CHIP8_STAT(stats.opClass[OPC_ADD_REG]++);
           int16_t add = V[x] + V[y];
 
           if (add > 255)
@@ -172,6 +330,7 @@ void Chip8::step()
         }
         case 0x5: // SUB Vx, Vy
         {
+          CHIP8_STAT(stats.opClass[OPC_SUB]++);
           if (V[y] > V[x])
             V[F] = 0;
           else
@@ -182,6 +341,7 @@ void Chip8::step()
         }
         case 0x6: // SHR Vx {, Vy}
         {
+          CHIP8_STAT(stats.opClass[OPC_SHR]++);
           if (!shiftUsingVY)
           {
             V[F] = V[x] & 0x01;
@@ -197,6 +357,7 @@ void Chip8::step()
         }
         case 0x7: // SUBN Vx, Vy
         {
+          CHIP8_STAT(stats.opClass[OPC_SUBN]++);
           if (V[x] > V[y])
             V[F] = 0;
           else
@@ -207,6 +368,7 @@ void Chip8::step()
         }
         case 0xE: // SHL Vx {,Vy}
         {
+          CHIP8_STAT(stats.opClass[OPC_SHL]++);
           if (!shiftUsingVY)
           {
             V[F] = ((V[x] & 0x80) >> 7);
@@ -221,6 +383,7 @@ void Chip8::step()
         }
         default:
         {
+          CHIP8_STAT(stats.opClass[OPC_UNKNOWN]++);
           //std::cout << "Unknown instruction:" << opcode;
           break;
         }
@@ -231,36 +394,50 @@ void Chip8::step()
     case 0x9: // SNE Vx, Vy
     {
       if (n != 0)
+      {
+        CHIP8_STAT(stats.opClass[OPC_UNKNOWN]++);
         break;
+      }
 
+      CHIP8_STAT(stats.opClass[OPC_SNE_REG]++);
+      CHIP8_STAT(stats.skipsTested++);
       if (V[x] != V[y])
+      {
+        CHIP8_STAT(stats.skipsTaken++);
         PC += 2;
+      }
 
       break;
     }
     case 0xa: // LD I, addr
     {
+      CHIP8_STAT(stats.opClass[OPC_LD_I]++);
       I = nnn;
       break;
     }
     case 0xb: // JP V0 + addr
     {
+      CHIP8_STAT(stats.opClass[OPC_JP_V0]++);
       PC = (nnn + V[0]) & 0xfff;
       break;
     }
     case 0xc: // RND Vx, byte
     {
+      CHIP8_STAT(stats.opClass[OPC_RND]++);
       int32_t r = (rand() % 255);
       V[x] = r & kk;
       break;
     }
     case 0xd: // DRW Vx, Vy, nibble
     {
+      CHIP8_STAT(stats.opClass[OPC_DRW]++);
+      CHIP8_STAT(stats.drawCalls++);
       V[F] = 0;
       for (int32_t i = 0; i < n; i++)
       {
         uint8_t sprite = Memory[I + i];
         int32_t row = (V[y] + i) % 32;
+        rowSeq[row] = frameSeq + 1;
 
         for (int32_t f = 0; f < 8; f++)
         {
@@ -282,6 +459,8 @@ void Chip8::step()
           sprite <<= 1;
         }
       }
+      CHIP8_STAT(stats.drawCollisions += V[F]);
+      publish_frame();
       break;
     }
     case 0xe:
@@ -290,20 +469,31 @@ void Chip8::step()
       {
         case 0x9e: // SKP Vx
         {
-          if (keyPressed == V[x])
+          CHIP8_STAT(stats.opClass[OPC_SKP]++);
+          CHIP8_STAT(stats.skipsTested++);
+          if (keys & (1 << (V[x] & 0xf)))
+          {
+            CHIP8_STAT(stats.skipsTaken++);
             PC += 2;
+          }
 
           break;
         }
         case 0xA1: // SKNP Vx
         {
-          if (keyPressed != V[x])
+          CHIP8_STAT(stats.opClass[OPC_SKNP]++);
+          CHIP8_STAT(stats.skipsTested++);
+          if (!(keys & (1 << (V[x] & 0xf))))
+          {
+            CHIP8_STAT(stats.skipsTaken++);
             PC += 2;
+          }
 
           break;
         }
         default:
         {
+          CHIP8_STAT(stats.opClass[OPC_UNKNOWN]++);
           //std::cout << "Unknown instruction:" << opcode;
           break;
         }
@@ -316,29 +506,58 @@ void Chip8::step()
       {
         case 0x07: // LD Vx, DT
         {
+          CHIP8_STAT(stats.opClass[OPC_LD_VX_DT]++);
           V[x] = DT;
           break;
         }
         case 0x0a: // LD Vx, K
         {
-          if (keyPressed != 0xff)
-            V[x] = keyPressed;
-          else
+          CHIP8_STAT(stats.opClass[OPC_LD_VX_K]++);
+          //Completes only once a key has been pressed *and* released, like
+          //the original COSMAC VIP. Until then the instruction repeats.
+          if (keyWaiting < 0)
+          {
+            for (int32_t k = 0; k < 16; k++)
+            {
+              if (keys & (1 << k))
+              {
+                keyWaiting = k;
+                break;
+              }
+            }
+            PC -= 2;
+          }
+          else if (keys & (1 << keyWaiting))
+          {
             PC -= 2;
+          }
+          else
+          {
+            V[x] = keyWaiting;
+            keyWaiting = -1;
+          }
           break;
         }
         case 0x15: // LD DT, Vx
         {
+          CHIP8_STAT(stats.opClass[OPC_LD_DT_VX]++);
           DT = V[x];
           break;
         }
         case 0x18: // LD ST, Vx
         {
+          CHIP8_STAT(stats.opClass[OPC_LD_ST_VX]++);
+          if (ST == 0 && V[x] > 0)
+            emit_tone(true);
+          else if (ST > 0 && V[x] == 0)
+            emit_tone(false);
+
           ST = V[x];
           break;
         }
         case 0x1e: // ADD I, Vx
         {
+          CHIP8_STAT(stats.opClass[OPC_ADD_I]++);
           // From Wikipedia:
           // VF is set to 1 when there is a range overflow (I+VX>0xFFF), and to
           // 0 when there isn't. This is an undocumented feature of the CHIP - 8
@@ -355,12 +574,14 @@ void Chip8::step()
         }
         case 0x29: // LD F, Vx
         {
+          CHIP8_STAT(stats.opClass[OPC_LD_F]++);
           I = V[x] * 5;
           I &= 0xfff;
           break;
         }
         case 0x33: // LD B, Vx
         {
+          CHIP8_STAT(stats.opClass[OPC_LD_B]++);
           uint8_t bcd = V[x];
           uint8_t unit = bcd % 10;
           bcd = bcd / 10;
@@ -374,6 +595,7 @@ void Chip8::step()
         }
         case 0x55: // LD [I], Vx
         {
+          CHIP8_STAT(stats.opClass[OPC_LD_MEM_VX]++);
           for (int32_t i = 0; i <= x; i++)
             Memory[I + i] = V[i];
 
@@ -385,6 +607,7 @@ void Chip8::step()
         }
         case 0x65: // LD Vx, [I]
         {
+          CHIP8_STAT(stats.opClass[OPC_LD_VX_MEM]++);
           for (int32_t i = 0; i <= x; i++)
             V[i] = Memory[I + i];
 
@@ -396,6 +619,7 @@ void Chip8::step()
         }
         default:
         {
+          CHIP8_STAT(stats.opClass[OPC_UNKNOWN]++);
           //std::cout << "Not implemented: " << opcode;
           break;
         }
@@ -403,4 +627,7 @@ void Chip8::step()
       break;
     }
   }
-}
\ No newline at end of file
+
+  if (++tickCycle >= cyclesPerTick)
+    tick_timers();
+}
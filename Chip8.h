@@ -16,7 +16,52 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include "Chip8Phosphor.h"
+#include "Chip8Stats.h"
+#include "SpscRing.h"
+#include "TripleBuffer.h"
+
+///A complete display image handed from the core to the renderer.
+struct Chip8Frame
+{
+  ///One palette index per pixel, see Chip8::PIXEL_OFF and PIXEL_ON.
+  uint8_t pixels[64 * 32];
+
+  ///The display after phosphor persistence, one glow level per pixel from 0
+  ///to Chip8Phosphor::LEVELS - 1. Only filled in when 'glowing' is set.
+  uint8_t glow[64 * 32];
+  bool glowing;
+
+  ///Value of Chip8::cycles when the frame was published.
+  uint64_t cycle;
+
+  ///Increases by one with every published frame, across reboots.
+  uint32_t seq;
+
+  ///The seq of the frame that last changed each row. A reader that skipped
+  ///frames can still tell which rows differ from the last frame it used.
+  uint32_t rowSeq[32];
+
+  ///Finds the span of rows changed since frame 'since'. Returns false if none.
+  bool dirty_rows(uint32_t since, int &first, int &count) const
+  {
+    first = 32;
+    int last = -1;
+    for (int row = 0; row < 32; row++)
+    {
+      if (rowSeq[row] > since)
+      {
+        if (row < first)
+          first = row;
+        last = row;
+      }
+    }
+    count = last - first + 1;
+    return last >= 0;
+  }
+};
 
 ///Some helper functions to do common bit operations in chip8
 #define mask_nnn(o) (o & 0x0fff)         ///Masks the lower 3 nibbles
@@ -28,6 +73,31 @@
 #define mask_high(o) ((o & 0xff00) >> 8) ///Masks the high byte
 #define mask_low(o) (o & 0x00ff)         ///Masks the lower byte
 
+///An edge of the sound timer's tone, stamped with the emulated time it happened at.
+struct ToneEvent
+{
+  ///The 60Hz timer tick the edge falls in, and how far into it.
+  uint64_t tick;
+  uint32_t cycle;
+  uint32_t cyclesPerTick;
+
+  bool on;
+};
+
+///Everything a running program can see, for save states. Host side state
+///(held keys, the emulated timeline) isn't part of it.
+struct Chip8Snapshot
+{
+  uint8_t memory[4096];
+  uint8_t display[64 * 32];
+  uint8_t V[16];
+  int16_t stack[16];
+  int16_t SP, I, PC;
+  uint8_t DT, ST;
+  uint64_t cycles;
+  bool shiftUsingVY, incrementIOnLD;
+};
+
 ///Describes a Chip8 machine including its memory, registers, and display configuration.
 class Chip8
 {
@@ -76,13 +146,36 @@ public:
 
   ///These 8 bit registers are used as timers. They are auto-decremented @ 60Hz,
   ///when they are non-zero. When ST is non-zero, the chip8 produces a 'tone'.
-  ///NOTE: These registers are to be auto-decremented *external* to the chip8.
+  ///The 60Hz is emulated time: they tick every cyclesPerTick instructions.
   uint8_t DT, ST;
 
+  ///Instructions executed per 60Hz timer tick. Set by whoever runs the core,
+  ///from the emulation speed.
+  uint32_t cyclesPerTick = 10;
+
+  ///Number of timer ticks so far. It is never reset, not even by boot(), so
+  ///the emulated timeline stays continuous for the sound.
+  uint64_t timerTicks = 0;
+
+  ///A copy of timerTicks for other threads to read.
+  std::atomic<uint64_t> sharedTimerTicks{0};
+
+  ///Instructions executed since the last timer tick.
+  uint32_t tickCycle = 0;
+
+  ///Tone on/off edges for the sound engine to render, in emulated time.
+  ///Edges are dropped if nobody consumes them.
+  SpscRing<ToneEvent> toneEvents{64};
+
+  ///Number of instructions executed since boot. Not part of the chip8 itself,
+  ///but used as the emulated time base by the debugging tools.
+  uint64_t cycles;
+
   ///Helper variables that aren't part of chip8 definition:
   const int16_t F = 15; // Index to the 16th V register.
-  const uint32_t PIXEL_OFF = 0xc8c8c8c8;
-  const uint32_t PIXEL_ON = 0x0a0a0a0a;
+  ///Palette indices written to the display. The renderer picks the colours.
+  static const uint8_t PIXEL_OFF = 0;
+  static const uint8_t PIXEL_ON = 1;
 
   ///Defines the 'top' of ROM space. 0x000 to 0x1FF are reserved by the ROM.
   const int16_t ROMTOP = 512;
@@ -98,12 +191,34 @@ public:
   ///for LD [I], Vx instruction. When enabled, this flag emulates the behaviour.
   bool incrementIOnLD = false;
 
-  ///Holds the value of the key currently being pressed.
-  uint8_t keyPressed;
+  ///The state of the 16 key hex keypad, one bit per key (bit n = key n held).
+  ///Only the thread running the core writes it; key events reach it through
+  ///the input queue.
+  uint16_t keys;
+
+  ///The key Fx0A saw go down and is now waiting to be released, or -1.
+  int8_t keyWaiting;
+
+  ///The display memory of chip8. Only the thread running the core may touch
+  ///it; other threads read the published copies in 'frames'.
+  uint8_t *display;
+
+  ///Completed display images, published by the core after every CLS and DRW.
+  TripleBuffer<Chip8Frame> frames;
+
+  ///The seq of the last published frame, and of the frame that last changed
+  ///each display row. Only the core thread uses these.
+  uint32_t frameSeq = 0;
+  uint32_t rowSeq[32] = {};
 
-  ///The display memory of chip8.
-  ///TODO: Convert to byte array.
-  uint32_t *display;
+  ///Keeps pixels glowing for a while after they go off, fed with every display
+  ///state so sprites flickering from XOR redraws look solid. Off by default.
+  Chip8Phosphor phosphor;
+
+#ifdef CHIP8_STATS
+  ///Instrumentation counters, only present when built with CHIP8_STATS.
+  Chip8Stats stats;
+#endif
 
   Chip8();
   ~Chip8();
@@ -113,4 +228,25 @@ public:
 
   ///Loads the chip8 with a program.
   void boot(char program[], int32_t len);
+
+  ///Copies the machine state into 'snapshot'.
+  void save_state(Chip8Snapshot &snapshot) const;
+
+  ///Puts the machine back into a saved state and publishes its display. The
+  ///emulated timeline carries on, so the sound stays continuous.
+  void load_state(const Chip8Snapshot &snapshot);
+
+  ///Returns true if the core is stuck in Fx0A waiting for a key, with no
+  ///timer running and no pixel fading, so nothing can change until a key
+  ///event arrives.
+  bool idle() const;
+
+  ///Copies the display into the frame buffer and publishes it.
+  void publish_frame();
+
+  ///Decrements DT and ST and starts the next 60Hz frame. Called from step().
+  void tick_timers();
+
+  ///Records a tone edge at the current emulated time.
+  void emit_tone(bool on);
 };
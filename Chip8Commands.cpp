@@ -0,0 +1,77 @@
+#include "Chip8Commands.h"
+
+std::future<void> Chip8CommandQueue::post(Chip8Command &command)
+{
+  std::future<void> done = command.done.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    commands.push_back(std::move(command));
+    queued.store(true, std::memory_order_release);
+  }
+
+  if (notify != nullptr)
+    notify();
+  return done;
+}
+
+std::future<void> Chip8CommandQueue::boot(const char *program, int32_t len,
+                                          std::shared_ptr<Chip8Snapshot> snapshot)
+{
+  Chip8Command command;
+  command.type = CMD_BOOT;
+  command.program.assign(program, program + len);
+  command.snapshot = snapshot;
+  return post(command);
+}
+
+std::future<void> Chip8CommandQueue::reset()
+{
+  Chip8Command command;
+  command.type = CMD_RESET;
+  return post(command);
+}
+
+std::future<void> Chip8CommandQueue::set_quirks(bool shiftUsingVY, bool incrementIOnLD)
+{
+  Chip8Command command;
+  command.type = CMD_SET_QUIRKS;
+  command.shiftUsingVY = shiftUsingVY;
+  command.incrementIOnLD = incrementIOnLD;
+  return post(command);
+}
+
+std::future<void> Chip8CommandQueue::save_state(std::shared_ptr<Chip8Snapshot> snapshot)
+{
+  Chip8Command command;
+  command.type = CMD_SAVE_STATE;
+  command.snapshot = snapshot;
+  return post(command);
+}
+
+std::future<void> Chip8CommandQueue::load_state(std::shared_ptr<Chip8Snapshot> snapshot)
+{
+  Chip8Command command;
+  command.type = CMD_LOAD_STATE;
+  command.snapshot = snapshot;
+  return post(command);
+}
+
+std::future<void> Chip8CommandQueue::step(int count)
+{
+  Chip8Command command;
+  command.type = CMD_STEP;
+  command.count = count;
+  return post(command);
+}
+
+bool Chip8CommandQueue::pop(Chip8Command &command)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (commands.empty())
+    return false;
+
+  command = std::move(commands.front());
+  commands.pop_front();
+  queued.store(!commands.empty(), std::memory_order_release);
+  return true;
+}
@@ -0,0 +1,91 @@
+/** Carries commands that change the whole machine (boot,  **/
+/** reset, quirks, save states, single steps) from the UI   **/
+/** thread to the core thread. The core runs them between   **/
+/** its 60Hz frames, never in the middle of one, and in the **/
+/** order they were posted, so e.g. a load state followed   **/
+/** by some steps needs no waiting in between. Each command **/
+/** returns a future that is ready once the core ran it.    **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Chip8.h"
+
+enum Chip8CommandType
+{
+  CMD_BOOT,
+  CMD_RESET,
+  CMD_SET_QUIRKS,
+  CMD_SAVE_STATE,
+  CMD_LOAD_STATE,
+  CMD_STEP
+};
+
+struct Chip8Command
+{
+  Chip8CommandType type;
+
+  ///CMD_BOOT: the program to load.
+  std::vector<char> program;
+
+  ///CMD_SET_QUIRKS: the new settings.
+  bool shiftUsingVY = false;
+  bool incrementIOnLD = false;
+
+  ///CMD_SAVE_STATE writes the state here, CMD_LOAD_STATE reads it from here.
+  ///A CMD_BOOT with a snapshot resumes from it instead of starting afresh.
+  std::shared_ptr<Chip8Snapshot> snapshot;
+
+  ///CMD_STEP: how many instructions to run.
+  int count = 0;
+
+  std::promise<void> done;
+};
+
+class Chip8CommandQueue
+{
+private:
+  std::mutex mutex;
+  std::deque<Chip8Command> commands;
+
+  ///Set while commands are queued, so the core can check for them every
+  ///frame without taking the mutex.
+  std::atomic<bool> queued{false};
+
+  std::future<void> post(Chip8Command &command);
+
+public:
+  ///Called after every command is posted, e.g. to wake a sleeping core.
+  void (*notify)() = nullptr;
+
+  ///UI thread. The program is copied, so it may be freed straight away. If
+  ///'snapshot' is given the game resumes from it, though a reset still
+  ///starts the program from the beginning.
+  std::future<void> boot(const char *program, int32_t len,
+                         std::shared_ptr<Chip8Snapshot> snapshot = nullptr);
+
+  ///UI thread. Boots the last booted program again.
+  std::future<void> reset();
+
+  std::future<void> set_quirks(bool shiftUsingVY, bool incrementIOnLD);
+
+  ///UI thread. 'snapshot' must not be touched until the future is ready.
+  std::future<void> save_state(std::shared_ptr<Chip8Snapshot> snapshot);
+  std::future<void> load_state(std::shared_ptr<Chip8Snapshot> snapshot);
+
+  ///UI thread. Runs 'count' instructions, whatever state the machine is in.
+  std::future<void> step(int count);
+
+  ///Core thread. True if a command is waiting.
+  bool pending() const { return queued.load(std::memory_order_acquire); }
+
+  ///Core thread. Takes the oldest command. Returns false if there is none.
+  bool pop(Chip8Command &command);
+};
@@ -0,0 +1,141 @@
+#include "Chip8Grid.h"
+
+bool Chip8Grid::start()
+{
+  if (thread != nullptr)
+    return true;
+
+  quit = false;
+  thread = SDL_CreateThread(run, "Chip8GridThread", this);
+  return thread != nullptr;
+}
+
+void Chip8Grid::stop()
+{
+  if (thread == nullptr)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  wake.notify_one();
+  SDL_WaitThread(thread, NULL);
+  thread = nullptr;
+}
+
+int Chip8Grid::add(const std::string &name, char program[], int32_t len, bool shiftUsingVY, bool incrementIOnLD)
+{
+  //Booted before it's shared, so the runner never sees it half set up.
+  std::unique_ptr<Chip8GridInstance> instance(new Chip8GridInstance());
+  instance->name = name;
+  instance->machine.shiftUsingVY = shiftUsingVY;
+  instance->machine.incrementIOnLD = incrementIOnLD;
+  instance->machine.boot(program, len);
+
+  int index;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    instances.push_back(std::move(instance));
+    index = (int)instances.size() - 1;
+  }
+  wake.notify_one();
+
+  start();
+  return index;
+}
+
+void Chip8Grid::remove(int index)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (index >= 0 && index < (int)instances.size())
+    instances.erase(instances.begin() + index);
+}
+
+void Chip8Grid::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  instances.clear();
+}
+
+void Chip8Grid::set_paused(bool _paused)
+{
+  if (paused == _paused)
+    return;
+
+  //Changed under the mutex so the runner can't miss the wake up between
+  //checking 'paused' and going to sleep.
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    paused = _paused;
+  }
+  wake.notify_one();
+}
+
+void Chip8Grid::set_key(int key, bool down)
+{
+  if (down)
+    keys |= (uint16_t)(1 << key);
+  else
+    keys &= (uint16_t)~(1 << key);
+}
+
+void Chip8Grid::run_frame(Chip8GridInstance &instance, int speed, uint16_t held)
+{
+  Chip8 &machine = instance.machine;
+  machine.keys = held;
+
+  //The same spreading as the main core: frames average exactly speed / 60.
+  instance.tickRemainder += speed;
+  int cycles = instance.tickRemainder / 60;
+  instance.tickRemainder %= 60;
+  machine.cyclesPerTick = cycles > 0 ? cycles : 1;
+
+  uint64_t tick = machine.timerTicks;
+  while (machine.timerTicks == tick)
+    machine.step();
+}
+
+int Chip8Grid::run(void *data)
+{
+  Chip8Grid *grid = (Chip8Grid *)data;
+
+  //Frames are due at fixed times from 'start', so sleep rounding doesn't add up.
+  uint32_t start = SDL_GetTicks();
+  uint32_t frames = 0;
+
+  while (!grid->quit)
+  {
+    {
+      std::unique_lock<std::mutex> lock(grid->mutex);
+      if (grid->instances.empty() || grid->paused)
+      {
+        grid->wake.wait(lock, [grid] { return grid->quit || (!grid->instances.empty() && !grid->paused); });
+
+        //Frames missed while asleep are not caught up.
+        start = SDL_GetTicks();
+        frames = 0;
+        continue;
+      }
+
+      int speed = grid->speed;
+      uint16_t held = grid->keys;
+      for (auto &instance : grid->instances)
+        grid->run_frame(*instance, speed, held);
+    }
+
+    frames++;
+    uint32_t due = start + (uint32_t)((uint64_t)frames * 1000 / 60);
+    uint32_t now = SDL_GetTicks();
+    if (now < due)
+      SDL_Delay(due - now);
+    else if (now - due > 250)
+    {
+      //Too far behind to catch up, e.g. after the machine slept. Start over.
+      start = now;
+      frames = 0;
+    }
+  }
+
+  return 0;
+}
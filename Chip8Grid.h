@@ -0,0 +1,85 @@
+/** Runs a set of extra chip8 machines side by side, e.g.   **/
+/** one ROM under different quirks, or different revisions  **/
+/** of a game. A single thread runs them all, one emulated  **/
+/** 60Hz frame of each machine per pass, so dozens of them  **/
+/** cost one thread and a few thousand instructions a frame.**/
+/** They share one keypad and make no sound. The thread is  **/
+/** started by the first add() and sleeps while the grid is **/
+/** empty or paused.                                        **/
+
+#pragma once
+
+#include <SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Chip8.h"
+
+///One machine in the grid.
+struct Chip8GridInstance
+{
+  Chip8 machine;
+  std::string name;
+
+  ///Spreads the instruction rate evenly over the 60Hz frames. Runner thread only.
+  int tickRemainder = 0;
+};
+
+class Chip8Grid
+{
+private:
+  ///Held by the runner while it steps the machines, and by anyone adding or
+  ///removing one.
+  std::mutex mutex;
+  std::vector<std::unique_ptr<Chip8GridInstance>> instances;
+
+  SDL_Thread *thread = nullptr;
+  std::atomic<bool> quit{false};
+  std::atomic<bool> paused{false};
+
+  ///Signalled, with 'mutex', when the runner may have work again or must quit.
+  std::condition_variable wake;
+
+  ///Held keys, one bit per chip8 key, shared by every machine.
+  std::atomic<uint16_t> keys{0};
+
+  static int run(void *data);
+
+  ///Starts the runner thread.
+  bool start();
+
+  ///Runs one emulated 60Hz frame of a machine.
+  void run_frame(Chip8GridInstance &instance, int speed, uint16_t held);
+
+public:
+  ///Instructions per second for every machine.
+  std::atomic<int> speed{600};
+
+  ~Chip8Grid() { stop(); }
+
+  ///Stops the runner thread. The machines are kept.
+  void stop();
+
+  ///Stops or resumes every machine. The runner sleeps while they are stopped.
+  void set_paused(bool _paused);
+  bool is_paused() const { return paused; }
+
+  ///Boots a new machine with a program and the given quirks, starting the
+  ///runner if it isn't going yet. Returns its index.
+  int add(const std::string &name, char program[], int32_t len, bool shiftUsingVY, bool incrementIOnLD);
+
+  void remove(int index);
+  void clear();
+
+  ///The number of machines. Only the thread that adds and removes them may
+  ///rely on it, or on the references below, staying valid.
+  int size() const { return (int)instances.size(); }
+  Chip8GridInstance &instance(int index) { return *instances[index]; }
+
+  ///Presses or releases a key on every machine.
+  void set_key(int key, bool down);
+};
@@ -0,0 +1,29 @@
+#include "Chip8Input.h"
+
+bool Chip8InputQueue::push(uint32_t hostTime, uint8_t key, bool pressed)
+{
+  InputEvent event;
+  event.hostTime = hostTime;
+  event.key = key;
+  event.pressed = pressed;
+  return events.push(event);
+}
+
+bool Chip8InputQueue::apply_due(Chip8 &chip, uint32_t scheduledTime)
+{
+  const InputEvent *next = events.peek();
+
+  //Ticks wrap after ~49 days, so compare by signed difference.
+  if (next == nullptr || (int32_t)(next->hostTime - scheduledTime) > 0)
+    return false;
+
+  InputEvent event;
+  events.pop(event);
+
+  if (event.pressed)
+    chip.keys |= 1 << event.key;
+  else
+    chip.keys &= ~(1 << event.key);
+
+  return true;
+}
@@ -0,0 +1,45 @@
+/** Carries key events from the UI thread to the core      **/
+/** thread. Events are stamped with the host time at which **/
+/** they happened, and the core applies each one at the    **/
+/** first instruction scheduled at or after that time.     **/
+
+#pragma once
+
+#include <cstdint>
+
+#include "Chip8.h"
+#include "SpscRing.h"
+
+struct InputEvent
+{
+  ///Host time of the event, in SDL ticks.
+  uint32_t hostTime;
+
+  ///Chip8 key, 0x0 to 0xf.
+  uint8_t key;
+  bool pressed;
+};
+
+class Chip8InputQueue
+{
+private:
+  SpscRing<InputEvent> events;
+
+public:
+  Chip8InputQueue() : events(256) {}
+
+  ///UI thread. Returns false if the queue is full and the event was dropped.
+  bool push(uint32_t hostTime, uint8_t key, bool pressed);
+
+  ///Core thread. Applies the oldest event if it happened at or before the
+  ///scheduled host time of the next instruction. At most one event is applied
+  ///per instruction, so a press and its release never land on the same cycle
+  ///and even the shortest tap is seen by the program.
+  bool apply_due(Chip8 &chip, uint32_t scheduledTime);
+
+  ///Core thread. True if no event is waiting to be applied.
+  bool empty() const { return events.empty(); }
+
+  ///Core thread. Drops all pending events.
+  void clear() { events.clear(); }
+};
@@ -0,0 +1,149 @@
+#include "Chip8Pacer.h"
+#include <iostream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define cpu_relax() _mm_pause()
+#else
+#define cpu_relax()
+#endif
+
+//Bounds on how far short of a deadline the coarse sleep stops. The spin
+//covers the rest, so this is traded against CPU time.
+static const double minSpinMarginUs = 200.0;
+static const double maxSpinMarginUs = 4000.0;
+
+//A deadline missed by more than this restarts the schedule.
+static const double resyncLateUs = 100000.0;
+
+void PacerStats::reset()
+{
+  waits = 0;
+  lastLateUs = 0;
+  maxLateUs = 0;
+  jitterUs = 0.0f;
+  spinUs = 0.0f;
+  resyncs = 0;
+  for (int i = 0; i < historySize; i++)
+    lateHistory[i] = 0;
+}
+
+Chip8Pacer::Chip8Pacer() : frequency(1000000), oversleep(0.0)
+{
+}
+
+void Chip8Pacer::start()
+{
+  frequency = SDL_GetPerformanceFrequency();
+
+  //SDL_Delay typically oversleeps by up to a millisecond, which is where the
+  //estimate starts.
+  if (oversleep == 0.0)
+    oversleep = (double)us_to_ticks(1000.0);
+  deadline = SDL_GetPerformanceCounter();
+}
+
+void Chip8Pacer::wait_next(double seconds)
+{
+  deadline += (uint64_t)(seconds * frequency);
+  uint64_t now = SDL_GetPerformanceCounter();
+
+  //E.g. the machine was suspended or stopped in a debugger. Running flat out
+  //until the schedule caught up would only make things worse.
+  if (now > deadline && ticks_to_us(now - deadline) > resyncLateUs)
+  {
+    deadline = now;
+    stats.resyncs++;
+    return;
+  }
+
+  double marginUs = ticks_to_us((uint64_t)oversleep) + minSpinMarginUs;
+  if (marginUs > maxSpinMarginUs)
+    marginUs = maxSpinMarginUs;
+  uint64_t margin = us_to_ticks(marginUs);
+  stats.spinMarginUs.store((uint32_t)marginUs, std::memory_order_relaxed);
+
+  //Sleep in whole milliseconds while that can't run past the margin, and learn
+  //how much the OS oversleeps from each one.
+  while (now + margin < deadline)
+  {
+    uint32_t ms = (uint32_t)((deadline - margin - now) * 1000 / frequency);
+    if (ms == 0)
+      break;
+
+    SDL_Delay(ms);
+    uint64_t woke = SDL_GetPerformanceCounter();
+    double over = (double)(woke - now) - (double)us_to_ticks(ms * 1000.0);
+    if (over < 0.0)
+      over = 0.0;
+    oversleep += (over - oversleep) * 0.1;
+    now = woke;
+  }
+
+  uint64_t spinStart = now;
+  while (now < deadline)
+  {
+    cpu_relax();
+    now = SDL_GetPerformanceCounter();
+  }
+
+  float lateUs = (float)ticks_to_us(now - deadline);
+  float spin = (float)ticks_to_us(now - spinStart);
+
+  PacerStats &st = stats;
+  st.waits.fetch_add(1, std::memory_order_relaxed);
+  st.lastLateUs.store((uint32_t)lateUs, std::memory_order_relaxed);
+  if ((uint32_t)lateUs > st.maxLateUs.load(std::memory_order_relaxed))
+    st.maxLateUs.store((uint32_t)lateUs, std::memory_order_relaxed);
+
+  float jitter = st.jitterUs.load(std::memory_order_relaxed);
+  st.jitterUs.store(jitter + (lateUs - jitter) * 0.05f, std::memory_order_relaxed);
+  float spinAverage = st.spinUs.load(std::memory_order_relaxed);
+  st.spinUs.store(spinAverage + (spin - spinAverage) * 0.05f, std::memory_order_relaxed);
+
+  uint32_t pos = st.lateHistoryPos.load(std::memory_order_relaxed);
+  st.lateHistory[pos % PacerStats::historySize].store((uint32_t)lateUs, std::memory_order_relaxed);
+  st.lateHistoryPos.store(pos + 1, std::memory_order_relaxed);
+}
+
+bool Chip8Pacer::set_realtime(bool on)
+{
+#ifdef __linux__
+  //The lowest real-time priority is still above every normal thread, and
+  //leaves room for audio servers that run higher.
+  sched_param param;
+  param.sched_priority = on ? sched_get_priority_min(SCHED_FIFO) : 0;
+  if (pthread_setschedparam(pthread_self(), on ? SCHED_FIFO : SCHED_OTHER, &param) != 0)
+  {
+    if (on)
+      std::cout << "Real-time scheduling refused, CAP_SYS_NICE or an rtprio limit is needed." << std::endl;
+    return false;
+  }
+  return true;
+#else
+  return SDL_SetThreadPriority(on ? SDL_THREAD_PRIORITY_TIME_CRITICAL : SDL_THREAD_PRIORITY_NORMAL) == 0;
+#endif
+}
+
+bool Chip8Pacer::pin_to_cpu(int cpu)
+{
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+  {
+    std::cout << "Unable to pin the core thread to CPU " << cpu << std::endl;
+    return false;
+  }
+  return true;
+#else
+  std::cout << "CPU pinning is only supported on Linux." << std::endl;
+  return false;
+#endif
+}
@@ -0,0 +1,82 @@
+/** Keeps the core in step with real time. Deadlines come   **/
+/** from the high resolution performance counter and are    **/
+/** absolute, so errors never accumulate. Waiting is a      **/
+/** coarse SDL_Delay that stops short of the deadline by    **/
+/** how much the OS has been seen to oversleep, followed by **/
+/** a short spin for the rest.                              **/
+
+#pragma once
+
+#include <SDL.h>
+#include <atomic>
+#include <cstdint>
+
+///How late the pacer woke up, in microseconds. Written by the core thread,
+///read from anywhere.
+struct PacerStats
+{
+  static constexpr int historySize = 128;
+
+  std::atomic<uint64_t> waits{0};
+
+  ///Lateness of the last wake up, the worst so far, and a running average of
+  ///its size.
+  std::atomic<uint32_t> lastLateUs{0};
+  std::atomic<uint32_t> maxLateUs{0};
+  std::atomic<float> jitterUs{0.0f};
+
+  ///How far short of the deadline the coarse sleep aims, and the running
+  ///average of time spent spinning per wait.
+  std::atomic<uint32_t> spinMarginUs{0};
+  std::atomic<float> spinUs{0.0f};
+
+  ///Times the core fell so far behind that the schedule was restarted.
+  std::atomic<uint64_t> resyncs{0};
+
+  ///Lateness of the last historySize waits.
+  std::atomic<uint32_t> lateHistory[historySize];
+  std::atomic<uint32_t> lateHistoryPos{0};
+
+  PacerStats()
+  {
+    for (int i = 0; i < historySize; i++)
+      lateHistory[i] = 0;
+  }
+
+  void reset();
+};
+
+class Chip8Pacer
+{
+private:
+  uint64_t frequency;
+  uint64_t deadline = 0;
+
+  //Average amount SDL_Delay oversleeps by, in counter ticks.
+  double oversleep;
+
+  uint64_t us_to_ticks(double us) const { return (uint64_t)(us * frequency / 1000000.0); }
+  double ticks_to_us(uint64_t ticks) const { return ticks * 1000000.0 / frequency; }
+
+public:
+  PacerStats stats;
+
+  Chip8Pacer();
+
+  ///Starts a new schedule, with the first deadline now.
+  void start();
+
+  ///Moves the deadline on by 'seconds' and waits until it. A deadline
+  ///missed by more than a few frames restarts the schedule instead of
+  ///running flat out to catch up.
+  void wait_next(double seconds);
+
+  ///Switches the calling thread to real-time scheduling, or back to normal.
+  ///On Linux this is SCHED_FIFO, which usually needs extra privileges;
+  ///elsewhere the thread priority is raised instead. Returns false if refused.
+  static bool set_realtime(bool on);
+
+  ///Pins the calling thread to one CPU. Linux only; returns false elsewhere
+  ///or if refused.
+  static bool pin_to_cpu(int cpu);
+};
@@ -0,0 +1,130 @@
+#include "Chip8Phosphor.h"
+#include <cmath>
+#include <cstring>
+
+#if !defined(CHIP8_NO_SIMD) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CHIP8_PHOSPHOR_SSE2
+#include <emmintrin.h>
+#endif
+
+//The glow index of a brightness is its top four bits.
+static const int glowShift = 4;
+
+void Chip8Phosphor::set_persistence(float kept)
+{
+  if (kept < 0.0f)
+    kept = 0.0f;
+  if (kept > 0.99f)
+    kept = 0.99f;
+
+  keep = (int)std::lround(kept * 256.0f);
+}
+
+int Chip8Phosphor::follow_keep()
+{
+  int kept = keep;
+  if (keptBefore == 0 && kept != 0)
+    memset(level, 0, sizeof(level));
+  keptBefore = kept;
+  return kept;
+}
+
+void Chip8Phosphor::light(const uint8_t *display, uint8_t *glow)
+{
+  int i = 0;
+
+  //Clears the levels first if persistence has just been turned back on. Until
+  //the next fade() has looked, assume anything drawn may fade.
+  glowLeft = follow_keep() != 0;
+
+#ifdef CHIP8_PHOSPHOR_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi8(-1);
+  const __m128i lowBits = _mm_set1_epi8(LEVELS - 1);
+
+  for (; i + 16 <= 64 * 32; i += 16)
+  {
+    //Lit pixels become 0xff, and a brightness can only go up here.
+    __m128i on = _mm_xor_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(display + i)), zero), ones);
+    __m128i now = _mm_or_si128(_mm_loadu_si128((const __m128i *)(level + i)), on);
+
+    _mm_storeu_si128((__m128i *)(level + i), now);
+    _mm_storeu_si128((__m128i *)(glow + i), _mm_and_si128(_mm_srli_epi16(now, glowShift), lowBits));
+  }
+#endif
+
+  for (; i < 64 * 32; i++)
+  {
+    if (display[i] != 0)
+      level[i] = 255;
+    glow[i] = level[i] >> glowShift;
+  }
+}
+
+uint32_t Chip8Phosphor::fade(const uint8_t *display)
+{
+  int kept = follow_keep();
+  glowLeft = false;
+  if (kept == 0)
+    return 0;
+
+  uint32_t changedRows = 0;
+
+#ifdef CHIP8_PHOSPHOR_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi8(-1);
+  const __m128i highBits = _mm_set1_epi8((char)0xf0);
+  const __m128i scale = _mm_set1_epi16((short)kept);
+
+  //Off pixels that still glow, across the whole display.
+  __m128i unlit = zero;
+#endif
+
+  for (int row = 0; row < 32; row++)
+  {
+    uint8_t *l = level + row * 64;
+    const uint8_t *d = display + row * 64;
+    int x = 0;
+
+#ifdef CHIP8_PHOSPHOR_SSE2
+    //Bits that flipped anywhere in the row. The glow changed if any were in a top nibble.
+    __m128i flipped = zero;
+
+    for (; x + 16 <= 64; x += 16)
+    {
+      __m128i old = _mm_loadu_si128((const __m128i *)(l + x));
+      __m128i on = _mm_xor_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(d + x)), zero), ones);
+
+      //level * kept / 256, in 16 bits.
+      __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(old, zero), scale), 8);
+      __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(old, zero), scale), 8);
+      __m128i now = _mm_or_si128(_mm_packus_epi16(lo, hi), on);
+
+      _mm_storeu_si128((__m128i *)(l + x), now);
+      flipped = _mm_or_si128(flipped, _mm_xor_si128(old, now));
+      unlit = _mm_or_si128(unlit, _mm_andnot_si128(on, now));
+    }
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(flipped, highBits), zero)) != 0xffff)
+      changedRows |= 1u << row;
+#endif
+
+    for (; x < 64; x++)
+    {
+      uint8_t old = l[x];
+      l[x] = d[x] != 0 ? 255 : (uint8_t)((old * kept) >> 8);
+      if ((old >> glowShift) != (l[x] >> glowShift))
+        changedRows |= 1u << row;
+      if (d[x] == 0 && (l[x] >> glowShift) != 0)
+        glowLeft = true;
+    }
+  }
+
+#ifdef CHIP8_PHOSPHOR_SSE2
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(unlit, highBits), zero)) != 0xffff)
+    glowLeft = true;
+#endif
+
+  return changedRows;
+}
@@ -0,0 +1,56 @@
+/** Phosphor persistence for the chip8 display. Sprites are **/
+/** erased and redrawn with XOR, so a pixel can be off in   **/
+/** the frame that happens to be shown even though it's on  **/
+/** most of the time. Like a CRT, every pixel that lights   **/
+/** up here stays lit and then fades out over a few 60Hz    **/
+/** frames, which hides the flicker. The core feeds it      **/
+/** every display state, not just the ones that get shown.  **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+class Chip8Phosphor
+{
+private:
+  ///Brightness of each pixel, 0 to 255.
+  uint8_t level[64 * 32] = {};
+
+  ///How much brightness a pixel keeps each 60Hz frame, out of 256. 0 turns
+  ///persistence off. Set from the UI thread while the core is running.
+  std::atomic<int> keep{0};
+
+  ///Set by fade() while some pixel that is off still shows a glow.
+  bool glowLeft = false;
+
+  ///The 'keep' seen by the last light() or fade(). Core thread only.
+  int keptBefore = 0;
+
+  ///Returns the current 'keep'. Levels stop being updated while persistence
+  ///is off, so they are cleared when it comes back on, or they would show
+  ///what was on screen back then.
+  int follow_keep();
+
+public:
+  ///Number of glow levels, and so of palette entries they need.
+  static const int LEVELS = 16;
+
+  ///Sets how much of its brightness a pixel keeps each 60Hz frame, from 0
+  ///(persistence off) to just under 1.
+  void set_persistence(float kept);
+  float get_persistence() const { return keep / 256.0f; }
+  bool enabled() const { return keep != 0; }
+
+  ///Brings every pixel that is on in 'display' to full brightness and writes
+  ///the glow, as indices 0 to LEVELS - 1, to 'glow'.
+  void light(const uint8_t *display, uint8_t *glow);
+
+  ///Dims every pixel that is off in 'display' by one 60Hz frame. Returns a
+  ///mask of the rows whose glow changed, bit n for row n.
+  uint32_t fade(const uint8_t *display);
+
+  ///True while fade() still has glow to take away, i.e. the picture will go
+  ///on changing with no further drawing.
+  bool fading() const { return glowLeft; }
+};
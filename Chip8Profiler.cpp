@@ -0,0 +1,152 @@
+#include "Chip8Profiler.h"
+#include <algorithm>
+#include <cstdio>
+
+void Chip8Profiler::sample(const Chip8 &chip)
+{
+  //Stack[1..SP] holds return addresses. The CALL that pushed each of them sits
+  //just before it, so the callee is the nnn of the opcode at (return - 2).
+  //The outermost frame is the program entry point.
+  uint16_t frames[MAX_DEPTH];
+  int depth = 0;
+  frames[depth++] = (uint16_t)chip.ROMTOP;
+
+  int32_t sp = chip.SP;
+  if (sp > MAX_DEPTH - 1)
+    sp = MAX_DEPTH - 1;
+
+  for (int32_t i = 1; i <= sp; i++)
+  {
+    int32_t site = (chip.Stack[i] - 2) & 0xfff;
+    uint16_t opcode = (chip.Memory[site] << 8) | chip.Memory[(site + 1) & 0xfff];
+
+    if (mask_xh(opcode) == 0x2)
+      frames[depth++] = mask_nnn(opcode);
+    else
+      frames[depth++] = UNKNOWN_FRAME;
+  }
+
+  totalSamples.fetch_add(1, std::memory_order_relaxed);
+
+  //A recursive subroutine only counts once towards its total.
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < depth; i++)
+  {
+    bool seen = false;
+    for (int j = 0; j < i; j++)
+      seen |= (frames[j] == frames[i]);
+
+    if (!seen)
+      totalCount[frame_index(frames[i])].fetch_add(1, std::memory_order_relaxed);
+
+    hash = (hash ^ frames[i]) * 16777619u;
+  }
+  selfCount[frame_index(frames[depth - 1])].fetch_add(1, std::memory_order_relaxed);
+
+  //Linear probing. Only the core writes slots, so claiming an empty one needs
+  //no compare-exchange; the release store publishes its frames to readers.
+  for (int probe = 0; probe < MAX_STACKS; probe++)
+  {
+    StackSlot &slot = stacks[(hash + probe) & (MAX_STACKS - 1)];
+
+    if (!slot.used.load(std::memory_order_relaxed))
+    {
+      slot.hash = hash;
+      slot.depth = (uint8_t)depth;
+      std::copy(frames, frames + depth, slot.frames);
+      slot.count.store(1, std::memory_order_relaxed);
+      slot.used.store(true, std::memory_order_release);
+      return;
+    }
+
+    if (slot.hash == hash && slot.depth == depth && std::equal(frames, frames + depth, slot.frames))
+    {
+      slot.count.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+}
+
+void Chip8Profiler::clear()
+{
+  for (StackSlot &slot : stacks)
+  {
+    slot.used.store(false, std::memory_order_relaxed);
+    slot.count.store(0, std::memory_order_relaxed);
+  }
+
+  for (int i = 0; i <= 4096; i++)
+  {
+    selfCount[i].store(0, std::memory_order_relaxed);
+    totalCount[i].store(0, std::memory_order_relaxed);
+  }
+
+  totalSamples.store(0, std::memory_order_relaxed);
+  nextSample = 0;
+  resetRequested.store(false, std::memory_order_release);
+}
+
+uint64_t Chip8Profiler::sample_count() const
+{
+  if (resetRequested.load(std::memory_order_acquire))
+    return 0;
+
+  return totalSamples.load(std::memory_order_relaxed);
+}
+
+std::vector<Chip8Profiler::HotEntry> Chip8Profiler::hot_subroutines(size_t maxEntries) const
+{
+  std::vector<HotEntry> result;
+  if (resetRequested.load(std::memory_order_acquire))
+    return result;
+
+  for (int i = 0; i <= 4096; i++)
+  {
+    uint64_t total = totalCount[i].load(std::memory_order_relaxed);
+    if (total > 0)
+    {
+      uint16_t address = (i == 4096) ? UNKNOWN_FRAME : (uint16_t)i;
+      result.push_back({address, selfCount[i].load(std::memory_order_relaxed), total});
+    }
+  }
+
+  //Partial sort is enough since the UI only shows the top few.
+  size_t count = result.size() < maxEntries ? result.size() : maxEntries;
+  std::partial_sort(result.begin(), result.begin() + count, result.end(),
+                    [](const HotEntry &a, const HotEntry &b) { return a.self > b.self; });
+  result.resize(count);
+  return result;
+}
+
+bool Chip8Profiler::write_folded(const char *path) const
+{
+  if (resetRequested.load(std::memory_order_acquire))
+    return false;
+
+  FILE *out = fopen(path, "w");
+  if (out == NULL)
+    return false;
+
+  for (const StackSlot &slot : stacks)
+  {
+    if (!slot.used.load(std::memory_order_acquire))
+      continue;
+
+    for (int i = 0; i < slot.depth; i++)
+    {
+      if (i > 0)
+        fputc(';', out);
+
+      if (slot.frames[i] == UNKNOWN_FRAME)
+        fputs("sub_unknown", out);
+      else if (i == 0)
+        fprintf(out, "main_%03x", slot.frames[i]);
+      else
+        fprintf(out, "sub_%03x", slot.frames[i]);
+    }
+    fprintf(out, " %llu\n", (unsigned long long)slot.count.load(std::memory_order_relaxed));
+  }
+
+  fclose(out);
+  return true;
+}
@@ -0,0 +1,101 @@
+/** A sampling profiler for chip8 programs. The guest call  **/
+/** stack is rebuilt from Stack[]/SP every N emulated cycles **/
+/** and aggregated so it can be exported in the 'folded'     **/
+/** format understood by flamegraph.pl, speedscope, etc.     **/
+/** Sampling runs on the core thread and never allocates or  **/
+/** locks; stacks go in a fixed table only the core writes.  **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Chip8.h"
+
+class Chip8Profiler
+{
+public:
+  ///Per subroutine sample counts. 'self' counts samples where the subroutine was
+  ///the innermost frame, 'total' where it appeared anywhere on the stack.
+  struct HotEntry
+  {
+    uint16_t address;
+    uint64_t self;
+    uint64_t total;
+  };
+
+  Chip8Profiler() { clear(); }
+
+  ///The profiler is only fed samples while this is set. Set from the UI thread
+  ///while the core is running.
+  std::atomic<bool> enabled{false};
+
+  ///Number of emulated cycles between two samples.
+  uint32_t sampleInterval = 64;
+
+  ///Called by the core thread after every step. Cheap unless a sample is due.
+  void tick(const Chip8 &chip)
+  {
+    if (resetRequested.load(std::memory_order_relaxed))
+      clear();
+
+    if (chip.cycles >= nextSample)
+    {
+      sample(chip);
+      nextSample = chip.cycles + sampleInterval;
+    }
+  }
+
+  ///Discards all samples collected so far. The core does the clearing before
+  ///its next sample; until then the readers below report nothing.
+  void reset() { resetRequested = true; }
+
+  ///Total number of samples collected.
+  uint64_t sample_count() const;
+
+  ///Returns up to maxEntries subroutines ordered by self samples.
+  std::vector<HotEntry> hot_subroutines(size_t maxEntries) const;
+
+  ///Writes the collected stacks in folded format, one "frame;frame;frame count" per line.
+  bool write_folded(const char *path) const;
+
+private:
+  ///Address used for a frame whose call site could not be decoded.
+  static constexpr uint16_t UNKNOWN_FRAME = 0xffff;
+
+  ///The program entry point plus one frame per stack entry.
+  static constexpr int MAX_DEPTH = 16;
+
+  ///Distinct stacks kept for the folded export. A power of two. Once the table
+  ///is full, new stacks still count towards the subroutines but aren't exported.
+  static constexpr int MAX_STACKS = 4096;
+
+  ///One distinct stack. The core fills in the frames, then sets 'used' with
+  ///release order, and never changes them again until a reset.
+  struct StackSlot
+  {
+    std::atomic<bool> used{false};
+    uint32_t hash = 0;
+    uint8_t depth = 0;
+    uint16_t frames[MAX_DEPTH] = {};
+    std::atomic<uint64_t> count{0};
+  };
+
+  StackSlot stacks[MAX_STACKS];
+
+  ///Per address sample counts, with the last entry for UNKNOWN_FRAME.
+  std::atomic<uint64_t> selfCount[4096 + 1];
+  std::atomic<uint64_t> totalCount[4096 + 1];
+
+  std::atomic<uint64_t> totalSamples{0};
+  std::atomic<bool> resetRequested{false};
+
+  ///Core thread only.
+  uint64_t nextSample = 0;
+
+  static int frame_index(uint16_t frame) { return frame == UNKNOWN_FRAME ? 4096 : frame & 0xfff; }
+
+  void sample(const Chip8 &chip);
+  void clear();
+};
@@ -0,0 +1,139 @@
+#include "Chip8RomLoader.h"
+#include <fstream>
+#include <iostream>
+
+//Programs load at 0x200, so anything past the top of memory is cut off.
+static const std::streamoff maxProgramSize = 4096 - 512;
+
+Chip8RomLoader::Chip8RomLoader(size_t capacity) : capacity(capacity)
+{
+  worker = std::thread(&Chip8RomLoader::worker_loop, this);
+}
+
+Chip8RomLoader::~Chip8RomLoader()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  wake.notify_one();
+  worker.join();
+}
+
+void Chip8RomLoader::worker_loop()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true)
+  {
+    wake.wait(lock, [this] { return quit || requested; });
+    if (quit)
+      return;
+
+    Chip8Rom rom;
+    rom.path = requestedPath;
+    uint32_t id = requestedId;
+    requested = false;
+    lock.unlock();
+
+    std::ifstream file(rom.path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (file.is_open())
+    {
+      std::streamoff size = file.tellg();
+      if (size > maxProgramSize)
+      {
+        std::cout << "ROM too big, truncated: " << rom.path << std::endl;
+        size = maxProgramSize;
+      }
+      rom.program.resize((size_t)size);
+      file.seekg(0, std::ios::beg);
+      file.read(rom.program.data(), size);
+    }
+    else
+      std::cout << "Unable to read file: " << rom.path << std::endl;
+
+    lock.lock();
+    result = std::move(rom);
+    resultId = id;
+    resultReady = true;
+  }
+}
+
+void Chip8RomLoader::remember(const Chip8Rom &rom)
+{
+  for (auto it = cache.begin(); it != cache.end(); ++it)
+  {
+    if (it->path == rom.path)
+    {
+      cache.erase(it);
+      break;
+    }
+  }
+
+  cache.push_front(rom);
+  if (cache.size() > capacity)
+    cache.pop_back();
+}
+
+bool Chip8RomLoader::request(const std::string &path, Chip8Rom &rom)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  //A newer request always replaces one still waiting for its file.
+  requestedId++;
+  requested = false;
+  waiting = false;
+
+  for (auto it = cache.begin(); it != cache.end(); ++it)
+  {
+    if (it->path == path)
+    {
+      cache.splice(cache.begin(), cache, it);
+      rom = *it;
+      return true;
+    }
+  }
+
+  requestedPath = path;
+  requested = true;
+  waiting = true;
+  wake.notify_one();
+  return false;
+}
+
+bool Chip8RomLoader::poll(Chip8Rom &rom)
+{
+  Chip8Rom read;
+  bool current;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!resultReady)
+      return false;
+
+    read = std::move(result);
+    current = resultId == requestedId && waiting;
+    resultReady = false;
+  }
+
+  //Even a ROM nobody's waiting for any more is worth keeping.
+  if (!read.program.empty())
+    remember(read);
+
+  if (!current)
+    return false;
+
+  waiting = false;
+  rom = std::move(read);
+  return true;
+}
+
+void Chip8RomLoader::set_snapshot(const std::string &path, std::shared_ptr<Chip8Snapshot> snapshot)
+{
+  for (Chip8Rom &rom : cache)
+  {
+    if (rom.path == path)
+    {
+      rom.snapshot = snapshot;
+      return;
+    }
+  }
+}
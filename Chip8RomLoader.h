@@ -0,0 +1,78 @@
+/** Reads ROM files on a background thread, so picking a    **/
+/** ROM never stalls the UI on file I/O, and keeps the most **/
+/** recently used ROMs in an LRU cache together with where  **/
+/** each game was left. Picking one of those again skips    **/
+/** the file and resumes the game from its snapshot.        **/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Chip8.h"
+
+struct Chip8Rom
+{
+  std::string path;
+
+  ///The program, or empty if the file couldn't be read.
+  std::vector<char> program;
+
+  ///Where the game was when it was last switched away from, or null.
+  std::shared_ptr<Chip8Snapshot> snapshot;
+};
+
+class Chip8RomLoader
+{
+private:
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool quit = false;
+
+  ///The file the worker should read next. Only the latest request counts; a
+  ///read finished for an older one is cached but not handed out.
+  std::string requestedPath;
+  uint32_t requestedId = 0;
+  bool requested = false;
+
+  ///The last file the worker read, waiting for poll().
+  Chip8Rom result;
+  uint32_t resultId = 0;
+  bool resultReady = false;
+
+  ///UI thread only. Most recently used first.
+  std::list<Chip8Rom> cache;
+  size_t capacity;
+  bool waiting = false;
+
+  void worker_loop();
+  void remember(const Chip8Rom &rom);
+
+public:
+  explicit Chip8RomLoader(size_t capacity = 8);
+  ~Chip8RomLoader();
+
+  ///UI thread. Asks for a ROM. If it's cached it is copied to 'rom' and true
+  ///is returned. Otherwise false is returned, the file is read in the
+  ///background and the ROM turns up from poll() later.
+  bool request(const std::string &path, Chip8Rom &rom);
+
+  ///UI thread. Takes the ROM asked for by the last request(), once it's
+  ///been read. Returns false until then.
+  bool poll(Chip8Rom &rom);
+
+  ///UI thread. True while a request is waiting for its file.
+  bool loading() const { return waiting; }
+
+  ///UI thread. Remembers where the game in 'path' was left, for the next
+  ///time it's picked. The snapshot may still be being filled in by the core,
+  ///as long as it is filled in before any command that reads it.
+  void set_snapshot(const std::string &path, std::shared_ptr<Chip8Snapshot> snapshot);
+};
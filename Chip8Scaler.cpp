@@ -0,0 +1,444 @@
+#include "Chip8Scaler.h"
+#include <cstring>
+
+//CHIP8_NO_SIMD builds only the scalar filters, so the tests can compare the two.
+#if !defined(CHIP8_NO_SIMD) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CHIP8_SCALER_SSE2
+#include <emmintrin.h>
+#endif
+
+//Every filter reads at most this many pixels away from the one it's scaling.
+static const int border = 2;
+
+const char* Chip8Scaler::filter_name(int filter)
+{
+  switch (filter)
+  {
+    case SCALE_2X:  return "Scale2x";
+    case SCALE_3X:  return "Scale3x";
+    case SCALE_4X:  return "Scale4x";
+    case SCALE_XBR: return "xBR 4x";
+    default:        return "None";
+  }
+}
+
+int Chip8Scaler::filter_factor(ScaleFilter filter)
+{
+  switch (filter)
+  {
+    case SCALE_2X:  return 2;
+    case SCALE_3X:  return 3;
+    case SCALE_4X:  return 4;
+    case SCALE_XBR: return 4;
+    default:        return 1;
+  }
+}
+
+const uint8_t* Chip8Scaler::pad(const uint8_t* pixels, int _width, int _height)
+{
+  int stride = _width + border * 2;
+  padded.resize(stride * (_height + border * 2));
+
+  //Pixels past the edge repeat the nearest edge pixel, so edges are never
+  //mistaken for shapes to smooth.
+  for (int y = -border; y < _height + border; y++)
+  {
+    int sy = y < 0 ? 0 : (y >= _height ? _height - 1 : y);
+    const uint8_t* in = pixels + sy * _width;
+    uint8_t* out = &padded[(y + border) * stride];
+
+    memset(out, in[0], border);
+    memcpy(out + border, in, _width);
+    memset(out + border + _width, in[_width - 1], border);
+  }
+
+  return &padded[border * stride + border];
+}
+
+/* Scalar filters. These do whatever the SSE2 loops leave at the end of a row. */
+
+//p points at pixel E in
+//  A B C
+//  D E F
+//  G H I
+//and 's' is the row stride.
+static inline void scale2x_pixel(const uint8_t* p, int s, uint8_t* o0, uint8_t* o1)
+{
+  uint8_t B = p[-s], D = p[-1], E = p[0], F = p[1], H = p[s];
+
+  if (B != H && D != F)
+  {
+    o0[0] = D == B ? D : E;
+    o0[1] = B == F ? F : E;
+    o1[0] = D == H ? D : E;
+    o1[1] = H == F ? F : E;
+  }
+  else
+    o0[0] = o0[1] = o1[0] = o1[1] = E;
+}
+
+static inline void scale3x_pixel(const uint8_t* p, int s, uint8_t* o0, uint8_t* o1, uint8_t* o2)
+{
+  uint8_t A = p[-s - 1], B = p[-s], C = p[-s + 1];
+  uint8_t D = p[-1], E = p[0], F = p[1];
+  uint8_t G = p[s - 1], H = p[s], I = p[s + 1];
+
+  if (B != H && D != F)
+  {
+    o0[0] = D == B ? D : E;
+    o0[1] = (D == B && E != C) || (B == F && E != A) ? B : E;
+    o0[2] = B == F ? F : E;
+    o1[0] = (D == B && E != G) || (D == H && E != A) ? D : E;
+    o1[1] = E;
+    o1[2] = (B == F && E != I) || (H == F && E != C) ? F : E;
+    o2[0] = D == H ? D : E;
+    o2[1] = (D == H && E != I) || (H == F && E != G) ? H : E;
+    o2[2] = H == F ? F : E;
+  }
+  else
+    o0[0] = o0[1] = o0[2] = o1[0] = o1[1] = o1[2] = o2[0] = o2[1] = o2[2] = E;
+}
+
+//The xBR corners, as the direction of each from the pixel centre. Where two
+//corners claim the same output pixel the later one wins.
+static const int cornerX[4] = {-1, 1, -1, 1};
+static const int cornerY[4] = {-1, -1, 1, 1};
+
+//Whether output pixel (i, j) of a 4x4 block is cut off by the edge across
+//corner c. That's the six pixels nearest the corner.
+static inline bool in_corner(int c, int i, int j)
+{
+  int u = cornerX[c] > 0 ? i : 3 - i;
+  int v = cornerY[c] > 0 ? j : 3 - j;
+  return u + v >= 4;
+}
+
+//The xBR edge rule for the corner of E toward (sx, sy), written for the bottom
+//right one and mirrored for the others:
+//         B
+//      D  E  F  F4
+//         H  I  I4
+//         H5 I5
+//If E differs from both F and H and the edge between them is more continuous
+//than the one through E and I, the corner belongs to F's side.
+static inline bool xbr_corner(const uint8_t* p, int s, int sx, int sy)
+{
+  auto at = [&](int dx, int dy) { return p[dy * sy * s + dx * sx]; };
+
+  uint8_t E = at(0, 0), F = at(1, 0), H = at(0, 1);
+  if (E == F || E == H)
+    return false;
+
+  uint8_t B = at(0, -1), C = at(1, -1), D = at(-1, 0), G = at(-1, 1), I = at(1, 1);
+  uint8_t F4 = at(2, 0), I4 = at(2, 1), H5 = at(0, 2), I5 = at(1, 2);
+
+  int across = (E != C) + (E != G) + (I != H5) + (I != F4) + 4 * (H != F);
+  int along = (H != D) + (H != I5) + (F != I4) + (F != B) + 4 * (E != I);
+  return across < along;
+}
+
+static inline void xbr_pixel(const uint8_t* p, int s, uint8_t* out, int outStride)
+{
+  uint8_t block[4][4];
+  memset(block, p[0], sizeof(block));
+
+  for (int c = 0; c < 4; c++)
+  {
+    if (!xbr_corner(p, s, cornerX[c], cornerY[c]))
+      continue;
+
+    uint8_t colour = p[cornerX[c]];
+    for (int j = 0; j < 4; j++)
+      for (int i = 0; i < 4; i++)
+        if (in_corner(c, i, j))
+          block[j][i] = colour;
+  }
+
+  for (int j = 0; j < 4; j++)
+    memcpy(out + j * outStride, block[j], 4);
+}
+
+/* SSE2 filters, sixteen source pixels at a time. Lane k of every vector holds */
+/* the neighbour of pixel x + k, loaded from a shifted address.                */
+
+#ifdef CHIP8_SCALER_SSE2
+static inline __m128i load(const uint8_t* p)
+{
+  return _mm_loadu_si128((const __m128i*)p);
+}
+
+static inline void store(uint8_t* p, __m128i v)
+{
+  _mm_storeu_si128((__m128i*)p, v);
+}
+
+//mask ? a : b, lane by lane.
+static inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+//Lanes where a and b differ.
+static inline __m128i differ(__m128i a, __m128i b)
+{
+  return _mm_xor_si128(_mm_cmpeq_epi8(a, b), _mm_set1_epi8(-1));
+}
+
+//Writes a0 b0 c0 a1 b1 c1 ... to 48 bytes at out. SSE2 has no byte shuffle to
+//do this in registers, so each triple is widened to 32 bits, pairs of those
+//are closed up into six bytes, and the quadwords are stored overlapping.
+static inline void interleave3(__m128i a, __m128i b, __m128i c, uint8_t* out)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i abLo = _mm_unpacklo_epi8(a, b), abHi = _mm_unpackhi_epi8(a, b);
+  __m128i cLo = _mm_unpacklo_epi8(c, zero), cHi = _mm_unpackhi_epi8(c, zero);
+
+  const __m128i low = _mm_set1_epi64x(0xffffff);
+  auto close = [&](__m128i words) {
+    return _mm_or_si128(_mm_and_si128(words, low), _mm_andnot_si128(low, _mm_srli_epi64(words, 8)));
+  };
+
+  __m128i q0 = close(_mm_unpacklo_epi16(abLo, cLo));
+  __m128i q1 = close(_mm_unpackhi_epi16(abLo, cLo));
+  __m128i q2 = close(_mm_unpacklo_epi16(abHi, cHi));
+  __m128i q3 = close(_mm_unpackhi_epi16(abHi, cHi));
+
+  _mm_storel_epi64((__m128i*)out, q0);
+  _mm_storel_epi64((__m128i*)(out + 6), _mm_srli_si128(q0, 8));
+  _mm_storel_epi64((__m128i*)(out + 12), q1);
+  _mm_storel_epi64((__m128i*)(out + 18), _mm_srli_si128(q1, 8));
+  _mm_storel_epi64((__m128i*)(out + 24), q2);
+  _mm_storel_epi64((__m128i*)(out + 30), _mm_srli_si128(q2, 8));
+  _mm_storel_epi64((__m128i*)(out + 36), q3);
+
+  //The last quadword would spill past the output, so it goes as six bytes.
+  uint8_t last[8];
+  _mm_storel_epi64((__m128i*)last, _mm_srli_si128(q3, 8));
+  memcpy(out + 42, last, 6);
+}
+
+static inline void scale2x_sse2(const uint8_t* p, int s, uint8_t* o0, uint8_t* o1)
+{
+  __m128i B = load(p - s), D = load(p - 1), E = load(p), F = load(p + 1), H = load(p + s);
+
+  __m128i guard = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi8(B, H), _mm_cmpeq_epi8(D, F)), _mm_set1_epi8(-1));
+  __m128i e0 = select(_mm_and_si128(guard, _mm_cmpeq_epi8(D, B)), D, E);
+  __m128i e1 = select(_mm_and_si128(guard, _mm_cmpeq_epi8(B, F)), F, E);
+  __m128i e2 = select(_mm_and_si128(guard, _mm_cmpeq_epi8(D, H)), D, E);
+  __m128i e3 = select(_mm_and_si128(guard, _mm_cmpeq_epi8(H, F)), F, E);
+
+  store(o0, _mm_unpacklo_epi8(e0, e1));
+  store(o0 + 16, _mm_unpackhi_epi8(e0, e1));
+  store(o1, _mm_unpacklo_epi8(e2, e3));
+  store(o1 + 16, _mm_unpackhi_epi8(e2, e3));
+}
+
+static inline void scale3x_sse2(const uint8_t* p, int s, uint8_t* o0, uint8_t* o1, uint8_t* o2)
+{
+  __m128i A = load(p - s - 1), B = load(p - s), C = load(p - s + 1);
+  __m128i D = load(p - 1), E = load(p), F = load(p + 1);
+  __m128i G = load(p + s - 1), H = load(p + s), I = load(p + s + 1);
+
+  __m128i guard = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi8(B, H), _mm_cmpeq_epi8(D, F)), _mm_set1_epi8(-1));
+  __m128i DB = _mm_and_si128(guard, _mm_cmpeq_epi8(D, B));
+  __m128i BF = _mm_and_si128(guard, _mm_cmpeq_epi8(B, F));
+  __m128i DH = _mm_and_si128(guard, _mm_cmpeq_epi8(D, H));
+  __m128i HF = _mm_and_si128(guard, _mm_cmpeq_epi8(H, F));
+  __m128i EA = differ(E, A), EC = differ(E, C), EG = differ(E, G), EI = differ(E, I);
+
+  interleave3(select(DB, D, E),
+              select(_mm_or_si128(_mm_and_si128(DB, EC), _mm_and_si128(BF, EA)), B, E),
+              select(BF, F, E), o0);
+  interleave3(select(_mm_or_si128(_mm_and_si128(DB, EG), _mm_and_si128(DH, EA)), D, E),
+              E,
+              select(_mm_or_si128(_mm_and_si128(BF, EI), _mm_and_si128(HF, EC)), F, E), o1);
+  interleave3(select(DH, D, E),
+              select(_mm_or_si128(_mm_and_si128(DH, EI), _mm_and_si128(HF, EG)), H, E),
+              select(HF, F, E), o2);
+}
+
+//Lanes where xbr_corner() holds.
+static inline __m128i xbr_corner_sse2(const uint8_t* p, int s, int sx, int sy)
+{
+  auto at = [&](int dx, int dy) { return load(p + dy * sy * s + dx * sx); };
+  //differ() is all ones or zero; these count 1 or 4 per difference.
+  auto one = [](__m128i m) { return _mm_and_si128(m, _mm_set1_epi8(1)); };
+  auto four = [](__m128i m) { return _mm_and_si128(m, _mm_set1_epi8(4)); };
+
+  __m128i E = at(0, 0), F = at(1, 0), H = at(0, 1);
+  __m128i B = at(0, -1), C = at(1, -1), D = at(-1, 0), G = at(-1, 1), I = at(1, 1);
+  __m128i F4 = at(2, 0), I4 = at(2, 1), H5 = at(0, 2), I5 = at(1, 2);
+
+  __m128i across = _mm_add_epi8(_mm_add_epi8(one(differ(E, C)), one(differ(E, G))),
+                                _mm_add_epi8(_mm_add_epi8(one(differ(I, H5)), one(differ(I, F4))), four(differ(H, F))));
+  __m128i along = _mm_add_epi8(_mm_add_epi8(one(differ(H, D)), one(differ(H, I5))),
+                               _mm_add_epi8(_mm_add_epi8(one(differ(F, I4)), one(differ(F, B))), four(differ(E, I))));
+
+  __m128i same = _mm_or_si128(_mm_cmpeq_epi8(E, F), _mm_cmpeq_epi8(E, H));
+  return _mm_andnot_si128(same, _mm_cmplt_epi8(across, along));
+}
+
+static inline void xbr_sse2(const uint8_t* p, int s, uint8_t* out, int outStride)
+{
+  __m128i E = load(p);
+  __m128i tl = select(xbr_corner_sse2(p, s, -1, -1), load(p - 1), E);
+  __m128i tr = select(xbr_corner_sse2(p, s, 1, -1), load(p + 1), E);
+  __m128i bl = select(xbr_corner_sse2(p, s, -1, 1), load(p - 1), E);
+  __m128i br = select(xbr_corner_sse2(p, s, 1, 1), load(p + 1), E);
+
+  //in_corner() worked out for the 4x4 block, later corners winning where two
+  //overlap. Only eight distinct columns come out of it.
+  __m128i tltr = select(_mm_cmpeq_epi8(tr, E), tl, tr);
+  __m128i tlbl = select(_mm_cmpeq_epi8(bl, E), tl, bl);
+  __m128i trbr = select(_mm_cmpeq_epi8(br, E), tr, br);
+  __m128i blbr = select(_mm_cmpeq_epi8(br, E), bl, br);
+
+  const __m128i block[4][4] = {
+    {tl,   tltr, tltr, tr},
+    {tlbl, tl,   tr,   trbr},
+    {tlbl, bl,   br,   trbr},
+    {bl,   blbr, blbr, br}};
+
+  //Interleave the four columns of each output row, 64 bytes at a time.
+  for (int j = 0; j < 4; j++)
+  {
+    __m128i lo01 = _mm_unpacklo_epi8(block[j][0], block[j][1]);
+    __m128i hi01 = _mm_unpackhi_epi8(block[j][0], block[j][1]);
+    __m128i lo23 = _mm_unpacklo_epi8(block[j][2], block[j][3]);
+    __m128i hi23 = _mm_unpackhi_epi8(block[j][2], block[j][3]);
+
+    uint8_t* o = out + j * outStride;
+    store(o, _mm_unpacklo_epi16(lo01, lo23));
+    store(o + 16, _mm_unpackhi_epi16(lo01, lo23));
+    store(o + 32, _mm_unpacklo_epi16(hi01, hi23));
+    store(o + 48, _mm_unpackhi_epi16(hi01, hi23));
+  }
+}
+
+static const int step = 16;
+#endif
+
+/* Whole images. 'src' is the first pixel of a padded image, 's' its stride. */
+
+static void scale2x(const uint8_t* src, int s, int w, int h, uint8_t* out)
+{
+  for (int y = 0; y < h; y++)
+  {
+    const uint8_t* p = src + y * s;
+    uint8_t* o0 = out + (y * 2) * (w * 2);
+    uint8_t* o1 = o0 + w * 2;
+
+    int x = 0;
+#ifdef CHIP8_SCALER_SSE2
+    for (; x + step <= w; x += step)
+      scale2x_sse2(p + x, s, o0 + x * 2, o1 + x * 2);
+#endif
+    for (; x < w; x++)
+      scale2x_pixel(p + x, s, o0 + x * 2, o1 + x * 2);
+  }
+}
+
+static void scale3x(const uint8_t* src, int s, int w, int h, uint8_t* out)
+{
+  for (int y = 0; y < h; y++)
+  {
+    const uint8_t* p = src + y * s;
+    uint8_t* o0 = out + (y * 3) * (w * 3);
+    uint8_t* o1 = o0 + w * 3;
+    uint8_t* o2 = o1 + w * 3;
+
+    int x = 0;
+#ifdef CHIP8_SCALER_SSE2
+    for (; x + step <= w; x += step)
+      scale3x_sse2(p + x, s, o0 + x * 3, o1 + x * 3, o2 + x * 3);
+#endif
+    for (; x < w; x++)
+      scale3x_pixel(p + x, s, o0 + x * 3, o1 + x * 3, o2 + x * 3);
+  }
+}
+
+static void xbr4x(const uint8_t* src, int s, int w, int h, uint8_t* out)
+{
+  for (int y = 0; y < h; y++)
+  {
+    const uint8_t* p = src + y * s;
+    uint8_t* o = out + (y * 4) * (w * 4);
+
+    int x = 0;
+#ifdef CHIP8_SCALER_SSE2
+    for (; x + step <= w; x += step)
+      xbr_sse2(p + x, s, o + x * 4, w * 4);
+#endif
+    for (; x < w; x++)
+      xbr_pixel(p + x, s, o + x * 4, w * 4);
+  }
+}
+
+const uint8_t* Chip8Scaler::scale(const uint8_t* pixels, int _width, int _height)
+{
+  int f = factor();
+  width = _width * f;
+  height = _height * f;
+
+  if (filter == SCALE_NONE)
+  {
+    output = pixels;
+    return output;
+  }
+
+  scaled.resize(width * height);
+  const uint8_t* src = pad(pixels, _width, _height);
+  int stride = _width + border * 2;
+
+  switch (filter)
+  {
+    case SCALE_2X:
+      scale2x(src, stride, _width, _height, scaled.data());
+      break;
+
+    case SCALE_3X:
+      scale3x(src, stride, _width, _height, scaled.data());
+      break;
+
+    case SCALE_4X:
+      middle.resize(width * height / 4);
+      scale2x(src, stride, _width, _height, middle.data());
+      src = pad(middle.data(), _width * 2, _height * 2);
+      scale2x(src, _width * 2 + border * 2, _width * 2, _height * 2, scaled.data());
+      break;
+
+    case SCALE_XBR:
+      xbr4x(src, stride, _width, _height, scaled.data());
+      break;
+
+    default:
+      break;
+  }
+
+  output = scaled.data();
+  return output;
+}
+
+void Chip8Scaler::scaled_rows(int first, int rows, int sourceHeight, int& scaledFirst, int& scaledRows) const
+{
+  int f = factor();
+
+  //A changed row alters the output of the rows around it too. Scale4x's
+  //second pass reaches one 2x row further, into the next source row.
+  int reach = 2;
+  if (filter == SCALE_NONE)
+    reach = 0;
+  else if (filter == SCALE_2X || filter == SCALE_3X)
+    reach = 1;
+  int last = first + rows + reach;
+  first -= reach;
+
+  if (first < 0)
+    first = 0;
+  if (last > sourceHeight)
+    last = sourceHeight;
+
+  scaledFirst = first * f;
+  scaledRows = (last - first) * f;
+}
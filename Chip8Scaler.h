@@ -0,0 +1,60 @@
+/** Pixel art upscalers for the chip8 display. Images are   **/
+/** palette indices, one byte per pixel, and the filters    **/
+/** only copy existing pixels, never blend them, so the     **/
+/** output is still indices and any palette can colour it.  **/
+/** Sixteen pixels are done per SSE2 step where available.  **/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+enum ScaleFilter
+{
+  SCALE_NONE,
+  SCALE_2X,   //Scale2x (AdvMAME2x)
+  SCALE_3X,   //Scale3x (AdvMAME3x)
+  SCALE_4X,   //Scale2x applied twice
+  SCALE_XBR,  //4x, corners cut along the edges found by the xBR edge rule
+  SCALE_FILTER_COUNT
+};
+
+class Chip8Scaler
+{
+private:
+  ScaleFilter filter = SCALE_NONE;
+  int width = 0;  //Size of the last scaled image
+  int height = 0;
+  const uint8_t* output = nullptr;
+
+  std::vector<uint8_t> padded; //Source with a two pixel border copied from its edges.
+  std::vector<uint8_t> middle; //Scale2x result that SCALE_4X scales again.
+  std::vector<uint8_t> scaled;
+
+  //Copies a width x height image into 'padded' and returns the address of its first pixel.
+  const uint8_t* pad(const uint8_t* pixels, int _width, int _height);
+
+public:
+  static const char* filter_name(int filter);
+
+  ///Returns how many output pixels each source pixel becomes along each axis.
+  static int filter_factor(ScaleFilter filter);
+
+  void set_filter(ScaleFilter _filter) { filter = _filter; }
+  ScaleFilter get_filter() const { return filter; }
+  int factor() const { return filter_factor(filter); }
+
+  ///Scales a width x height image of palette indices. The result stays valid
+  ///until the next call. With SCALE_NONE it's the source image itself.
+  const uint8_t* scale(const uint8_t* pixels, int _width, int _height);
+
+  ///The last scaled image and its size, for anything else that wants it, like
+  ///a screenshot or a recording.
+  const uint8_t* image() const { return output; }
+  int image_width() const { return width; }
+  int image_height() const { return height; }
+
+  ///Maps changed source rows [first, first + rows) of an image 'sourceHeight'
+  ///rows high to the scaled rows they can affect, as each filter reads its neighbours.
+  void scaled_rows(int first, int rows, int sourceHeight, int& scaledFirst, int& scaledRows) const;
+};
@@ -1,160 +1,127 @@
 #include "Chip8Sound.h"
-#include <SDL_audio.h>
-#include <cstring>
+#include <SDL.h>
 
-void play_callback(void *userData, unsigned char *audioData, int length)
+bool Chip8Sound::init()
 {
-	sdl_audio_ring_buffer *ringBuffer = (sdl_audio_ring_buffer *)userData;
-		
-	int region1Size = length;
-	int region2Size = 0;
-	if (ringBuffer->PlayCursor + length > ringBuffer->Size)
+	SdlAudioSink *device = new SdlAudioSink(samplesPerSecond / 4);
+	if (device->open(samplesPerSecond, devicePeriodSamples, maxQueueSamples))
 	{
-		region1Size = ringBuffer->Size - ringBuffer->PlayCursor;
-		region2Size = length - region1Size;
+		sink.reset(device);
+		return true;
 	}
-	memcpy(audioData, (unsigned char*)(ringBuffer->Data) + ringBuffer->PlayCursor, region1Size);
-	memcpy(&audioData[region1Size], ringBuffer->Data, region2Size);
-	ringBuffer->PlayCursor = (ringBuffer->PlayCursor + length) % ringBuffer->Size;
-	ringBuffer->WriteCursor = (ringBuffer->PlayCursor + 2048) % ringBuffer->Size;
-	ringBuffer->Length -= length;
+
+	delete device;
+	SDL_Log("No audio device, sound is disabled.");
+	init_null();
+	return false;
 }
 
-void Chip8Sound::init()
+bool Chip8Sound::init_file(const char *path)
 {
-	SDL_AudioSpec want;
-	SDL_memset(&want, 0, sizeof(want));
-
-	want.freq = samplesPerSecond;
-	want.format = AUDIO_S16LSB;
-	want.channels = 1;
-	want.samples =  bufferSize / want.channels;
-	want.callback = &play_callback;
-	want.userdata = &AudioRingBuffer;
-
-	DeviceID = SDL_OpenAudioDevice(NULL, 0, &want, &audioSpec, 0);
-
-	if (DeviceID == 0) 
+	FileAudioSink *file = new FileAudioSink();
+	if (!file->open(path, samplesPerSecond))
 	{
-		SDL_Log("Failed to open audio: %s", SDL_GetError());
+		delete file;
+		return false;
 	}
-	else 
-	{
-		if (audioSpec.format != want.format) 
-		{
-			SDL_Log("Couldn't set Float32 audio format.");
-		}
-		SDL_PauseAudioDevice(DeviceID, 0);
-	}
-	soundIsPlaying = false;
-	bytesPerSample = sizeof(short) * audioSpec.channels;
-	bufferSize = audioSpec.size;
-	AudioRingBuffer.Size = bufferSize;
-	AudioRingBuffer.Data = malloc(bufferSize);
-	AudioRingBuffer.PlayCursor = AudioRingBuffer.WriteCursor = AudioRingBuffer.Length = 0;
-}
 
-void Chip8Sound::play_single_buffer(bool playNote) 
-{
-	int queuedBytes = SDL_GetQueuedAudioSize(DeviceID);
-	int bytesToWrite = targetQueueBytes - queuedBytes;
+	sink.reset(file);
+	return true;
+}
 
-	if (bytesToWrite > 0)
-	{
-		int numSamples = audioSpec.samples * bytesPerSample;
-		int sampleCount = bytesToWrite / bytesPerSample;
-		void* soundBuffer = malloc(bytesToWrite);
-		short *sampleOut = (short *)soundBuffer;
+void Chip8Sound::init_null() { sink.reset(new NullAudioSink()); }
 
-		for (int sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex)
-		{
-			short tone = ((runningSampleIndex++ / halfSquareWavePeriod) % 2) ? toneVolume : audioSpec.silence;
-			short sample = playNote ? tone : audioSpec.silence;
-			
-			*sampleOut++ = sample;
-			if (audioSpec.channels == 2)
-				*sampleOut++ = sample;	
-		}
-
-		SDL_QueueAudio(DeviceID, soundBuffer, bytesToWrite);
-		
-		if (!soundIsPlaying)
-		{
-			SDL_PauseAudioDevice(DeviceID, 0);
-			soundIsPlaying = true;
-		}
-		free(soundBuffer);
-	}
-}
+void Chip8Sound::close() { sink.reset(); }
 
-void Chip8Sound::play_ring_buffer(bool playNote) 
+void Chip8Sound::render(Chip8 &chip)
 {
-	int secondaryBufferSize = audioSpec.size;// samplesPerSecond * bytesPerSample;
+	uint64_t target = chip.timerTicks;
 
-	SDL_LockAudio();
+	//Don't try to catch up on a long stretch nobody rendered, e.g. at start up.
+	if (target - renderedTick > 8)
+		renderedTick = target - 1;
 
-	int byteToLock = runningSampleIndex * bytesPerSample % secondaryBufferSize;
-	int bytesToWrite;
+	//Used to estimate when each tone edge happened in host time, assuming
+	//the just finished tick ended now.
+	uint64_t now = SDL_GetPerformanceCounter();
+	uint64_t frequency = SDL_GetPerformanceFrequency();
 
-	if (byteToLock == AudioRingBuffer.PlayCursor)
-	{
-		bytesToWrite = secondaryBufferSize;
-	} 
-	else if (byteToLock > AudioRingBuffer.PlayCursor)
-	{
-		bytesToWrite = (secondaryBufferSize - byteToLock);
-		bytesToWrite += AudioRingBuffer.PlayCursor;
-	}
-	else
-	{
-		bytesToWrite = AudioRingBuffer.PlayCursor - byteToLock;
-	}
-
-	void *region1 = (unsigned char *)AudioRingBuffer.Data + byteToLock;
+	synth.set_frequency(toneHz.load(std::memory_order_relaxed));
+	synth.set_volume(volume.load(std::memory_order_relaxed));
 
-	int region1Size = bytesToWrite;
+	while (renderedTick < target)
+	{
+		short samples[samplesPerFrame];
+		int pos = 0;
 
-  	if (region1Size + byteToLock > secondaryBufferSize)
-        region1Size = secondaryBufferSize - byteToLock;
+		while (const ToneEvent *event = chip.toneEvents.peek())
+		{
+			if (event->tick > renderedTick)
+				break;
+
+			//Edges from frames already rendered take effect straight away.
+			int edge = 0;
+			if (event->tick == renderedTick)
+			{
+				edge = (int)((uint64_t)event->cycle * samplesPerFrame / event->cyclesPerTick);
+				if (edge > samplesPerFrame)
+					edge = samplesPerFrame;
+			}
+
+			if (edge > pos)
+			{
+				synth.render(samples + pos, edge - pos, toneOn);
+				pos = edge;
+			}
+
+			if (event->on && !toneOn && sink)
+			{
+				uint64_t samplesAgo = (target - renderedTick) * samplesPerFrame - edge;
+				sink->mark_tone_start(edge, now - samplesAgo * frequency / samplesPerSecond);
+			}
+
+			toneOn = event->on;
+
+			ToneEvent done;
+			chip.toneEvents.pop(done);
+		}
 
-	void *region2 = AudioRingBuffer.Data;
-	int region2Size = bytesToWrite - region1Size;
+		synth.render(samples + pos, samplesPerFrame - pos, toneOn);
 
-	SDL_UnlockAudio();
+		if (sink)
+			sink->write(samples, samplesPerFrame);
 
-	int region1SampleCount = region1Size / bytesPerSample;
-	short *sampleOut = (short *)region1;
+		renderedTick++;
+	}
 
-	for (int sampleIndex = 0; sampleIndex < region1SampleCount; ++sampleIndex)
+	int queued = sink ? sink->queued() : -1;
+	if (queued < 0)
 	{
-		short tone = ((runningSampleIndex++ / halfSquareWavePeriod) % 2) ? toneVolume : audioSpec.silence;
-		short sample = playNote ? tone : audioSpec.silence;
-		*sampleOut++ = sample;
-
-		if (audioSpec.channels == 2)
-			*sampleOut++ = sample;
+		clockRatio.store(1.0f, std::memory_order_relaxed);
+		return;
 	}
 
-	int region2SampleCount = region2Size / bytesPerSample;
-	sampleOut = (short *)region2;
+	//A slow moving average of how far the fill is from target, turned into a
+	//small speed correction: too full means the core is ahead of the device.
+	float error = (queued - targetQueueSamples) / (float)targetQueueSamples;
+	fillError += (error - fillError) * 0.05f;
 
-	for (int sampleIndex = 0; sampleIndex < region2SampleCount; ++sampleIndex)
-	{
-		short tone = ((runningSampleIndex++ / halfSquareWavePeriod) % 2) ? toneVolume : audioSpec.silence;
-		short sample = playNote ? tone : audioSpec.silence;
-		*sampleOut++ = sample;
+	float correction = fillError;
+	if (correction > 1.0f)
+		correction = 1.0f;
+	if (correction < -1.0f)
+		correction = -1.0f;
 
-		if (audioSpec.channels == 2)
-			*sampleOut++ = sample;
-	}
+	clockRatio.store(1.0f - correction * maxClockCorrection, std::memory_order_relaxed);
+}
 
-	AudioRingBuffer.Length += bytesToWrite;
+void Chip8Sound::skip(Chip8 &chip)
+{
+	ToneEvent event;
+	while (chip.toneEvents.pop(event))
+		toneOn = event.on;
 
-	if (!soundIsPlaying)
-	{
-		SDL_PauseAudioDevice(DeviceID, 0);
-		soundIsPlaying = true;
-	}
+	renderedTick = chip.timerTicks;
 }
 
 Chip8Sound::~Chip8Sound() {}
@@ -1,43 +1,88 @@
-/** Uses a ring buffer to stream audio into a SDL buffer **/
+/** Renders the chip8 tone from the core's tone timeline,   **/
+/** one 60Hz frame at a time, and hands the samples to an   **/
+/** AudioSink: the SDL device, a file, or nothing at all.   **/
 
 #pragma once
-#include<SDL.h>
 
-struct sdl_audio_ring_buffer
-{
-	int Size;
-	int WriteCursor;
-	int PlayCursor;
-	int Length;
-	void *Data;
-};
+#include <atomic>
+#include <memory>
+
+#include "AudioSink.h"
+#include "Chip8.h"
+#include "Chip8Synth.h"
 
 class Chip8Sound
 {
 private:
 	static constexpr int samplesPerSecond = 48000;
-	static constexpr short toneVolume = 3000;
+	static constexpr int samplesPerFrame = samplesPerSecond / 60;
 
-	//See: https://www.seventhstring.com/resources/notefrequencies.html
-	static constexpr int toneHz = 440; //A4 (Standard tuning)
-	
-	unsigned int runningSampleIndex = 0;
-	static constexpr int squareWavePeriod = samplesPerSecond / toneHz;
-	static constexpr int halfSquareWavePeriod = squareWavePeriod / 2;
-	int bytesPerSample = sizeof(short) * 1; //num channels = 1
-	int bufferSize = (samplesPerSecond / 60);
-	
-	SDL_AudioSpec audioSpec;
-	int targetQueueBytes = samplesPerSecond * bytesPerSample;
-	bool soundIsPlaying;
+	Chip8Synth synth;
+	std::unique_ptr<AudioSink> sink;
+
+	//A device sink is the master clock. The core's speed is nudged so that
+	//the device's ring holds about targetQueueSamples; together with the
+	//device's own period that is 800 + 512 samples, about 27ms of latency
+	//at 48kHz.
+	static constexpr int devicePeriodSamples = 512;
+	static constexpr int targetQueueSamples = samplesPerFrame;
+	static constexpr int maxQueueSamples = samplesPerFrame * 4;
+
+	//The most the core's speed is ever adjusted by (0.5%), which is too
+	//little to notice but far more than any real clock drift.
+	static constexpr float maxClockCorrection = 0.005f;
+
+	//Smoothed ring fill error, owned by the thread calling render().
+	float fillError = 0.0f;
+	std::atomic<float> clockRatio{1.0f};
+
+	//Timeline state, owned by the thread calling render().
+	uint64_t renderedTick = 0;
+	bool toneOn = false;
 
 public:
-	sdl_audio_ring_buffer AudioRingBuffer;
-	SDL_AudioDeviceID DeviceID = 0;
+	///Tone settings, may be changed from any thread. They take effect from
+	///the next rendered frame.
+	//See: https://www.seventhstring.com/resources/notefrequencies.html
+	std::atomic<float> toneHz{440.0f}; //A4 (Standard tuning)
+	std::atomic<float> volume{0.1f};
+
+	Chip8Sound() : synth(samplesPerSecond) {}
+
+	///Plays through the default SDL audio device. If it can't be opened the
+	///sound goes to a null sink instead and false is returned.
+	bool init();
+
+	///Writes the sound to a .wav (or any other name for raw PCM) file.
+	bool init_file(const char *path);
+
+	///Discards the sound.
+	void init_null();
+
+	///Closes the current sink. Call before SDL_Quit().
+	void close();
+
+	///Renders every 60Hz frame the core has completed since the last call,
+	///placing tone edges at the sample matching their emulated cycle.
+	///Must be called from the thread running the core.
+	void render(Chip8 &chip);
+
+	///Passes over the frames the core has completed since the last call
+	///without playing them, for when it runs faster than real time. The
+	///tone state is still followed so render() can carry on from here.
+	void skip(Chip8 &chip);
+
+	///Whether the sink plays in real time. Sinks that aren't, like a file,
+	///can take every frame however fast the core runs.
+	bool clocked() const { return sink && sink->queued() >= 0; }
+
+	///How much faster (>1) or slower (<1) than nominal the core should run to
+	///keep pace with the audio device. Always 1 for sinks without a clock.
+	float clock_ratio() const { return clockRatio.load(std::memory_order_relaxed); }
+
+	///Latency and underrun counters of the current sink, or NULL if it doesn't
+	///play in real time.
+	const AudioStats *stats() const { return sink ? sink->stats() : NULL; }
 
-	void init();
-	void play_single_buffer(bool playNote);
-	void play_ring_buffer(bool playNote);
 	~Chip8Sound();
 };
-
@@ -0,0 +1,68 @@
+#include "Chip8Stats.h"
+#include <cstdio>
+#include <cstring>
+
+static const char *opClassNames[OPC_COUNT] = {
+    "CLS",       "RET",       "SYS",        "JP",        "CALL",
+    "SE Vx,kk",  "SNE Vx,kk", "SE Vx,Vy",   "LD Vx,kk",  "ADD Vx,kk",
+    "LD Vx,Vy",  "OR",        "AND",        "XOR",       "ADD Vx,Vy",
+    "SUB",       "SHR",       "SUBN",       "SHL",       "SNE Vx,Vy",
+    "LD I,nnn",  "JP V0,nnn", "RND",        "DRW",       "SKP",
+    "SKNP",      "LD Vx,DT",  "LD Vx,K",    "LD DT,Vx",  "LD ST,Vx",
+    "ADD I,Vx",  "LD F,Vx",   "LD B,Vx",    "LD [I],Vx", "LD Vx,[I]",
+    "UNKNOWN"};
+
+void Chip8Stats::reset()
+{
+  instructions = 0;
+  skipsTested = skipsTaken = 0;
+  drawCalls = drawCollisions = 0;
+  memset(opClass, 0, sizeof(opClass));
+  memset(pcCount, 0, sizeof(pcCount));
+}
+
+const char *Chip8Stats::op_class_name(int opClass)
+{
+  if (opClass < 0 || opClass >= OPC_COUNT)
+    return "?";
+
+  return opClassNames[opClass];
+}
+
+void Chip8Stats::write_json(std::ostream &out) const
+{
+  out << "{\n";
+  out << "  \"instructions\": " << instructions << ",\n";
+  out << "  \"skips_tested\": " << skipsTested << ",\n";
+  out << "  \"skips_taken\": " << skipsTaken << ",\n";
+  out << "  \"draw_calls\": " << drawCalls << ",\n";
+  out << "  \"draw_collisions\": " << drawCollisions << ",\n";
+
+  out << "  \"op_classes\": {";
+  bool first = true;
+  for (int32_t i = 0; i < OPC_COUNT; i++)
+  {
+    if (opClass[i] == 0)
+      continue;
+
+    out << (first ? "\n" : ",\n") << "    \"" << opClassNames[i] << "\": " << opClass[i];
+    first = false;
+  }
+  out << "\n  },\n";
+
+  //Only addresses that were actually executed are written, keyed by hex address.
+  out << "  \"pc_counts\": {";
+  first = true;
+  char addr[8];
+  for (int32_t i = 0; i < 4096; i++)
+  {
+    if (pcCount[i] == 0)
+      continue;
+
+    snprintf(addr, sizeof(addr), "0x%03x", i);
+    out << (first ? "\n" : ",\n") << "    \"" << addr << "\": " << pcCount[i];
+    first = false;
+  }
+  out << "\n  }\n";
+  out << "}\n";
+}
@@ -0,0 +1,71 @@
+/** Optional instrumentation counters for the chip8 core.   **/
+/** Build with -DCHIP8_STATS to enable them. When disabled, **/
+/** CHIP8_STAT() expands to nothing and the core is exactly **/
+/** as it was without the counters.                          **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+#ifdef CHIP8_STATS
+#define CHIP8_STAT(expr) (expr)
+#else
+#define CHIP8_STAT(expr) ((void)0)
+#endif
+
+///One entry per distinct instruction the core decodes.
+enum Chip8OpClass
+{
+  OPC_CLS, OPC_RET, OPC_SYS, OPC_JP, OPC_CALL, OPC_SE_BYTE, OPC_SNE_BYTE,
+  OPC_SE_REG, OPC_LD_BYTE, OPC_ADD_BYTE, OPC_LD_REG, OPC_OR, OPC_AND, OPC_XOR,
+  OPC_ADD_REG, OPC_SUB, OPC_SHR, OPC_SUBN, OPC_SHL, OPC_SNE_REG, OPC_LD_I,
+  OPC_JP_V0, OPC_RND, OPC_DRW, OPC_SKP, OPC_SKNP, OPC_LD_VX_DT, OPC_LD_VX_K,
+  OPC_LD_DT_VX, OPC_LD_ST_VX, OPC_ADD_I, OPC_LD_F, OPC_LD_B, OPC_LD_MEM_VX,
+  OPC_LD_VX_MEM, OPC_UNKNOWN,
+  OPC_COUNT
+};
+
+///Per-instance counter block. It is only ever written by the thread running
+///the core, so plain integers are used. Readers on other threads may see
+///slightly stale values, which is fine for statistics.
+struct Chip8Stats
+{
+  uint64_t instructions;
+  uint64_t opClass[OPC_COUNT];
+
+  ///Number of times each address in the 4k space was executed.
+  uint64_t pcCount[4096];
+
+  ///Conditional skips (3xkk, 4xkk, 5xy0, 9xy0, Ex9E, ExA1) executed, and how
+  ///many of them actually skipped.
+  uint64_t skipsTested;
+  uint64_t skipsTaken;
+
+  ///DRW instructions executed, and how many of them reported a collision.
+  uint64_t drawCalls;
+  uint64_t drawCollisions;
+
+  ///Set from any thread to have the core clear the counters before its next
+  ///instruction. Clearing them directly would race with the core's updates.
+  std::atomic<bool> resetRequested{false};
+
+  Chip8Stats() { reset(); }
+
+  ///Core thread only.
+  void reset();
+
+  ///Core thread. Clears the counters if another thread asked for it.
+  void reset_if_requested()
+  {
+    if (resetRequested.load(std::memory_order_relaxed) && resetRequested.exchange(false))
+      reset();
+  }
+
+  ///Writes the counters as a JSON object.
+  void write_json(std::ostream &out) const;
+
+  ///Returns the assembly mnemonic for an op class.
+  static const char *op_class_name(int opClass);
+};
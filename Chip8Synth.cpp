@@ -0,0 +1,134 @@
+#include "Chip8Synth.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHIP8_SYNTH_SSE2
+#include <emmintrin.h>
+#endif
+
+Chip8Synth::Chip8Synth(int _sampleRate) : sampleRate((float)_sampleRate)
+{
+  set_frequency(440.0f);
+  set_volume(0.1f);
+}
+
+void Chip8Synth::set_frequency(float hz)
+{
+  //Keeping the increment under 1/4 lets a block of four advance the phase
+  //by less than one period, so a single wrap is enough.
+  float maxHz = sampleRate / 4.0f;
+  if (hz > maxHz)
+    hz = maxHz;
+  if (hz < 1.0f)
+    hz = 1.0f;
+
+  increment = hz / sampleRate;
+}
+
+void Chip8Synth::set_volume(float volume)
+{
+  if (volume < 0.0f)
+    volume = 0.0f;
+  if (volume > 1.0f)
+    volume = 1.0f;
+
+  amplitude = volume * 32767.0f;
+}
+
+//PolyBLEP residual for a discontinuity at phase 0, t in 0..1.
+static inline float poly_blep(float t, float dt)
+{
+  if (t < dt)
+  {
+    float x = t / dt;
+    return x + x - x * x - 1.0f;
+  }
+  if (t > 1.0f - dt)
+  {
+    float x = (t - 1.0f) / dt;
+    return x * x + x + x + 1.0f;
+  }
+  return 0.0f;
+}
+
+static inline float square_sample(float t, float dt)
+{
+  //Rising edge at 0 and falling edge at 0.5.
+  float naive = t < 0.5f ? 1.0f : -1.0f;
+  float t2 = t + 0.5f;
+  if (t2 >= 1.0f)
+    t2 -= 1.0f;
+
+  return naive + poly_blep(t, dt) - poly_blep(t2, dt);
+}
+
+#ifdef CHIP8_SYNTH_SSE2
+//Branch-free PolyBLEP for four phases at once.
+static inline __m128 poly_blep4(__m128 t, __m128 dt, __m128 invDt)
+{
+  const __m128 one = _mm_set1_ps(1.0f);
+
+  __m128 x1 = _mm_mul_ps(t, invDt);
+  __m128 c1 = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(x1, x1), _mm_mul_ps(x1, x1)), one);
+  __m128 m1 = _mm_cmplt_ps(t, dt);
+
+  __m128 x2 = _mm_mul_ps(_mm_sub_ps(t, one), invDt);
+  __m128 c2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x2, x2), _mm_add_ps(x2, x2)), one);
+  __m128 m2 = _mm_cmpgt_ps(t, _mm_sub_ps(one, dt));
+
+  return _mm_or_ps(_mm_and_ps(m1, c1), _mm_and_ps(m2, c2));
+}
+#endif
+
+void Chip8Synth::render(int16_t *out, int count, bool gateOn)
+{
+  int i = 0;
+
+  if (!gateOn)
+  {
+    memset(out, 0, count * sizeof(int16_t));
+    phase += increment * count;
+    phase -= floorf(phase);
+    return;
+  }
+
+#ifdef CHIP8_SYNTH_SSE2
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 dt = _mm_set1_ps(increment);
+  const __m128 invDt = _mm_set1_ps(1.0f / increment);
+  const __m128 amp = _mm_set1_ps(amplitude);
+  const __m128 lanes = _mm_mul_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), dt);
+  const __m128 step = _mm_set1_ps(increment * 4.0f);
+
+  __m128 t = _mm_add_ps(_mm_set1_ps(phase), lanes);
+  t = _mm_sub_ps(t, _mm_and_ps(_mm_cmpge_ps(t, one), one));
+
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 naive = _mm_sub_ps(_mm_and_ps(_mm_cmplt_ps(t, half), _mm_set1_ps(2.0f)), one);
+
+    __m128 t2 = _mm_add_ps(t, half);
+    t2 = _mm_sub_ps(t2, _mm_and_ps(_mm_cmpge_ps(t2, one), one));
+
+    __m128 value = _mm_add_ps(naive, _mm_sub_ps(poly_blep4(t, dt, invDt), poly_blep4(t2, dt, invDt)));
+    __m128i samples = _mm_cvtps_epi32(_mm_mul_ps(value, amp));
+    _mm_storel_epi64((__m128i *)(out + i), _mm_packs_epi32(samples, samples));
+
+    t = _mm_add_ps(t, step);
+    t = _mm_sub_ps(t, _mm_and_ps(_mm_cmpge_ps(t, one), one));
+  }
+
+  //Carry on from the first lane of the next (unfinished) group.
+  phase = _mm_cvtss_f32(t);
+#endif
+
+  for (; i < count; i++)
+  {
+    out[i] = (int16_t)lrintf(square_sample(phase, increment) * amplitude);
+    phase += increment;
+    if (phase >= 1.0f)
+      phase -= 1.0f;
+  }
+}
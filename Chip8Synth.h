@@ -0,0 +1,31 @@
+/** Band-limited square wave oscillator for the chip8 tone. **/
+/** A phase accumulator drives the wave and PolyBLEP        **/
+/** smooths each edge, so the tone doesn't alias. Samples   **/
+/** are generated a block at a time, four per SSE2 step     **/
+/** where available.                                        **/
+
+#pragma once
+
+#include <cstdint>
+
+class Chip8Synth
+{
+private:
+  float sampleRate;
+  float phase = 0.0f;     //Position in the current period, 0..1.
+  float increment = 0.0f; //Phase advance per sample, frequency / sample rate.
+  float amplitude = 0.0f; //Peak sample value.
+
+public:
+  explicit Chip8Synth(int _sampleRate);
+
+  ///Sets the tone frequency. It is capped at a quarter of the sample rate.
+  void set_frequency(float hz);
+
+  ///Sets the volume, from 0 (silent) to 1 (full scale).
+  void set_volume(float volume);
+
+  ///Writes count mono samples. With the gate off the output is silence, but
+  ///the phase keeps running so the next note starts in step.
+  void render(int16_t *out, int count, bool gateOn);
+};
@@ -0,0 +1,440 @@
+#include "Chip8Trace.h"
+#include <chrono>
+#include <cstring>
+
+//Each record starts with a flags byte saying which fields follow. Fields that
+//are not flagged are unchanged from the previous record in the block.
+enum TraceFlags
+{
+  TRACE_CYCLE_SEQ = 0x01, //cycle is previous + 1, otherwise a varint delta follows
+  TRACE_PC_SEQ = 0x02,    //pc is previous pc + 2, otherwise u16 pc follows
+  TRACE_OP_CACHED = 0x04, //opcode is the last one seen at this pc, otherwise u16 follows
+  TRACE_V = 0x08,         //u16 mask of changed V registers, then one byte per set bit
+  TRACE_I = 0x10,         //u16 I
+  TRACE_SP = 0x20,        //u8 SP
+  TRACE_TIMERS = 0x40,    //u8 DT, u8 ST
+  TRACE_MEM = 0x80        //u16 address, u8 length, then the bytes written
+};
+
+//Records per block. Blocks are decoded independently so a reader can skip
+//straight to the block covering a cycle of interest.
+static constexpr uint32_t RECORDS_PER_BLOCK = 16384;
+
+static constexpr size_t RING_CAPACITY = 1 << 16;
+static const char TRACE_MAGIC[4] = {'C', '8', 'T', 'R'};
+static constexpr uint8_t TRACE_VERSION = 1;
+
+static void reset_state(TraceRecord &prev, uint16_t *opcodeCache, uint64_t baseCycle)
+{
+  memset(&prev, 0, sizeof(prev));
+  prev.cycle = baseCycle;
+  memset(opcodeCache, 0, sizeof(uint16_t) * 4096);
+}
+
+//Worst case size of one encoded record: flags, 10 byte varint, pc, opcode,
+//V mask and 16 registers, I, SP, timers, memory address, length and 16 bytes.
+static constexpr size_t MAX_RECORD_BYTES = 1 + 10 + 2 + 2 + 2 + 16 + 2 + 1 + 2 + 2 + 1 + 16;
+
+static uint8_t *put_u16(uint8_t *out, uint16_t v)
+{
+  *out++ = v & 0xff;
+  *out++ = v >> 8;
+  return out;
+}
+
+static void put_u32(uint8_t *out, uint32_t v)
+{
+  for (int32_t i = 0; i < 4; i++)
+    out[i] = (v >> (i * 8)) & 0xff;
+}
+
+static void put_u64(uint8_t *out, uint64_t v)
+{
+  for (int32_t i = 0; i < 8; i++)
+    out[i] = (v >> (i * 8)) & 0xff;
+}
+
+static uint8_t *put_varint(uint8_t *out, uint64_t v)
+{
+  while (v >= 0x80)
+  {
+    *out++ = (v & 0x7f) | 0x80;
+    v >>= 7;
+  }
+  *out++ = (uint8_t)v;
+  return out;
+}
+
+//Encodes one record at 'out', which must have MAX_RECORD_BYTES available.
+//Returns the position after the record.
+static uint8_t *encode(uint8_t *out, const TraceRecord &r, TraceRecord &prev, uint16_t *opcodeCache)
+{
+  uint8_t flags = 0;
+  uint16_t vMask = 0;
+
+  if (r.cycle == prev.cycle + 1)
+    flags |= TRACE_CYCLE_SEQ;
+  if (r.pc == (uint16_t)(prev.pc + 2))
+    flags |= TRACE_PC_SEQ;
+  if (opcodeCache[r.pc & 0xfff] == r.opcode)
+    flags |= TRACE_OP_CACHED;
+
+  for (int32_t i = 0; i < 16; i++)
+  {
+    if (r.V[i] != prev.V[i])
+      vMask |= 1 << i;
+  }
+
+  if (vMask != 0)
+    flags |= TRACE_V;
+  if (r.I != prev.I)
+    flags |= TRACE_I;
+  if (r.SP != prev.SP)
+    flags |= TRACE_SP;
+  if (r.DT != prev.DT || r.ST != prev.ST)
+    flags |= TRACE_TIMERS;
+  if (r.memLen > 0)
+    flags |= TRACE_MEM;
+
+  *out++ = flags;
+
+  if (!(flags & TRACE_CYCLE_SEQ))
+    out = put_varint(out, r.cycle - prev.cycle);
+  if (!(flags & TRACE_PC_SEQ))
+    out = put_u16(out, r.pc);
+  if (!(flags & TRACE_OP_CACHED))
+    out = put_u16(out, r.opcode);
+
+  if (flags & TRACE_V)
+  {
+    out = put_u16(out, vMask);
+    for (int32_t i = 0; i < 16; i++)
+    {
+      if (vMask & (1 << i))
+        *out++ = r.V[i];
+    }
+  }
+
+  if (flags & TRACE_I)
+    out = put_u16(out, r.I);
+  if (flags & TRACE_SP)
+    *out++ = (uint8_t)r.SP;
+  if (flags & TRACE_TIMERS)
+  {
+    *out++ = r.DT;
+    *out++ = r.ST;
+  }
+
+  if (flags & TRACE_MEM)
+  {
+    out = put_u16(out, r.memAddr);
+    *out++ = r.memLen;
+    memcpy(out, r.mem, r.memLen);
+    out += r.memLen;
+  }
+
+  prev = r;
+  opcodeCache[r.pc & 0xfff] = r.opcode;
+  return out;
+}
+
+Chip8Tracer::Chip8Tracer() : ring(RING_CAPACITY) {}
+
+Chip8Tracer::~Chip8Tracer() { stop(); }
+
+bool Chip8Tracer::start(const char *path)
+{
+  if (is_active())
+    return true;
+
+  file = fopen(path, "wb");
+  if (file == NULL)
+    return false;
+
+  fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), file);
+  fputc(TRACE_VERSION, file);
+
+  recordsWritten = 0;
+  bytesWritten = sizeof(TRACE_MAGIC) + 1;
+  producerStalls = 0;
+  ring.clear();
+
+  running = true;
+  writer = std::thread(&Chip8Tracer::writer_loop, this);
+  active = true;
+  return true;
+}
+
+void Chip8Tracer::stop()
+{
+  if (!is_active())
+    return;
+
+  //Handshake with the core thread: once active is cleared, wait for any step
+  //that already saw it set to finish pushing its record.
+  active.store(false);
+  while (inStep.load())
+    std::this_thread::yield();
+
+  running = false;
+  writer.join();
+
+  fclose(file);
+  file = NULL;
+}
+
+bool Chip8Tracer::before_step(const Chip8 &chip)
+{
+  if (!active.load(std::memory_order_relaxed))
+    return false;
+
+  inStep.store(true);
+  if (!active.load())
+  {
+    inStep.store(false);
+    return false;
+  }
+
+  pending.pc = chip.PC & 0xfff;
+  pending.opcode = (chip.Memory[pending.pc] << 8) | chip.Memory[(pending.pc + 1) & 0xfff];
+
+  //Only Fx33 and Fx55 write to memory, both starting at the current I.
+  pending.memLen = 0;
+  if (mask_xh(pending.opcode) == 0xf)
+  {
+    if (mask_low(pending.opcode) == 0x33)
+      pending.memLen = 3;
+    else if (mask_low(pending.opcode) == 0x55)
+      pending.memLen = mask_xl(pending.opcode) + 1;
+  }
+  pending.memAddr = chip.I & 0xfff;
+  return true;
+}
+
+void Chip8Tracer::after_step(const Chip8 &chip)
+{
+  pending.cycle = chip.cycles;
+  pending.I = chip.I;
+  pending.SP = chip.SP;
+  pending.DT = chip.DT;
+  pending.ST = chip.ST;
+  memcpy(pending.V, chip.V, sizeof(pending.V));
+
+  for (int32_t i = 0; i < pending.memLen; i++)
+    pending.mem[i] = chip.Memory[(pending.memAddr + i) & 0xfff];
+
+  //The trace must be complete, so rather than dropping records the core waits
+  //for the writer to catch up.
+  if (!ring.push(pending))
+  {
+    producerStalls.fetch_add(1, std::memory_order_relaxed);
+    while (!ring.push(pending))
+      std::this_thread::yield();
+  }
+
+  inStep.store(false, std::memory_order_release);
+}
+
+void Chip8Tracer::writer_loop()
+{
+  std::vector<uint8_t> block(16 + RECORDS_PER_BLOCK * MAX_RECORD_BYTES);
+  std::vector<uint16_t> opcodeCacheStorage(4096);
+  uint16_t *opcodeCache = opcodeCacheStorage.data();
+  uint8_t *payload = block.data() + 16;
+  uint8_t *out = payload;
+  uint32_t blockRecords = 0;
+  uint64_t baseCycle = 0;
+  TraceRecord prev;
+  TraceRecord r;
+
+  auto flush = [&]() {
+    if (blockRecords == 0)
+      return;
+
+    uint32_t bytes = (uint32_t)(out - payload);
+    put_u32(block.data(), blockRecords);
+    put_u32(block.data() + 4, bytes);
+    put_u64(block.data() + 8, baseCycle);
+    fwrite(block.data(), 1, 16 + bytes, file);
+
+    recordsWritten.fetch_add(blockRecords, std::memory_order_relaxed);
+    bytesWritten.fetch_add(16 + bytes, std::memory_order_relaxed);
+    out = payload;
+    blockRecords = 0;
+  };
+
+  while (true)
+  {
+    //Check before draining so that records pushed before stop() are not lost.
+    bool finishing = !running.load();
+    bool drained = false;
+
+    while (ring.pop(r))
+    {
+      if (blockRecords == 0)
+      {
+        baseCycle = r.cycle - 1;
+        reset_state(prev, opcodeCache, baseCycle);
+      }
+
+      out = encode(out, r, prev, opcodeCache);
+      drained = true;
+
+      if (++blockRecords == RECORDS_PER_BLOCK)
+        flush();
+    }
+
+    if (finishing)
+      break;
+
+    //Only sleep when the ring was already empty, so a busy core is never
+    //left waiting on a sleeping writer.
+    if (!drained)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  flush();
+  fflush(file);
+}
+
+Chip8TraceReader::~Chip8TraceReader() { close(); }
+
+bool Chip8TraceReader::open(const char *path)
+{
+  close();
+  file = fopen(path, "rb");
+  if (file == NULL)
+    return false;
+
+  char magic[4];
+  if (fread(magic, 1, 4, file) != 4 || memcmp(magic, TRACE_MAGIC, 4) != 0 ||
+      fgetc(file) != TRACE_VERSION)
+  {
+    close();
+    return false;
+  }
+
+  blockRecords = 0;
+  return true;
+}
+
+void Chip8TraceReader::close()
+{
+  if (file != NULL)
+  {
+    fclose(file);
+    file = NULL;
+  }
+}
+
+bool Chip8TraceReader::read_block()
+{
+  uint8_t header[16];
+  if (fread(header, 1, sizeof(header), file) != sizeof(header))
+    return false;
+
+  uint32_t bytes = 0;
+  uint64_t baseCycle = 0;
+  blockRecords = 0;
+  for (int32_t i = 0; i < 4; i++)
+  {
+    blockRecords |= (uint32_t)header[i] << (i * 8);
+    bytes |= (uint32_t)header[4 + i] << (i * 8);
+  }
+  for (int32_t i = 0; i < 8; i++)
+    baseCycle |= (uint64_t)header[8 + i] << (i * 8);
+
+  block.resize(bytes);
+  if (fread(block.data(), 1, bytes, file) != bytes)
+    return false;
+
+  blockPos = 0;
+  reset_state(prev, opcodeCache, baseCycle);
+  return true;
+}
+
+bool Chip8TraceReader::next(TraceRecord &r)
+{
+  if (file == NULL)
+    return false;
+
+  if (blockRecords == 0 && !read_block())
+    return false;
+
+  //Every read is bounds checked so a truncated file just ends the trace.
+  bool ok = true;
+  auto get = [&]() -> uint8_t {
+    if (blockPos >= block.size())
+    {
+      ok = false;
+      return 0;
+    }
+    return block[blockPos++];
+  };
+  auto get_u16 = [&]() -> uint16_t {
+    uint16_t lo = get();
+    return lo | (get() << 8);
+  };
+
+  uint8_t flags = get();
+  r = prev;
+  r.memLen = 0;
+
+  if (flags & TRACE_CYCLE_SEQ)
+    r.cycle = prev.cycle + 1;
+  else
+  {
+    uint64_t delta = 0;
+    uint8_t b;
+    int32_t shift = 0;
+    do
+    {
+      b = get();
+      delta |= (uint64_t)(b & 0x7f) << shift;
+      shift += 7;
+    } while ((b & 0x80) && ok && shift < 64);
+    r.cycle = prev.cycle + delta;
+  }
+
+  r.pc = (flags & TRACE_PC_SEQ) ? (uint16_t)(prev.pc + 2) : get_u16();
+  r.opcode = (flags & TRACE_OP_CACHED) ? opcodeCache[r.pc & 0xfff] : get_u16();
+
+  if (flags & TRACE_V)
+  {
+    uint16_t vMask = get_u16();
+    for (int32_t i = 0; i < 16; i++)
+    {
+      if (vMask & (1 << i))
+        r.V[i] = get();
+    }
+  }
+
+  if (flags & TRACE_I)
+    r.I = get_u16();
+  if (flags & TRACE_SP)
+    r.SP = (int8_t)get();
+  if (flags & TRACE_TIMERS)
+  {
+    r.DT = get();
+    r.ST = get();
+  }
+
+  if (flags & TRACE_MEM)
+  {
+    r.memAddr = get_u16();
+    r.memLen = get();
+    if (r.memLen > sizeof(r.mem))
+      ok = false;
+
+    for (int32_t i = 0; i < r.memLen && ok; i++)
+      r.mem[i] = get();
+  }
+
+  if (!ok)
+    return false;
+
+  prev = r;
+  opcodeCache[r.pc & 0xfff] = r.opcode;
+  blockRecords--;
+  return true;
+}
@@ -0,0 +1,107 @@
+/** Execution tracer for the chip8 core. The core thread    **/
+/** copies each executed instruction into a lock-free ring,  **/
+/** and a background thread delta-encodes the records and    **/
+/** streams them to disk in independently decodable blocks.  **/
+/**                                                          **/
+/** File layout (all values little-endian):                  **/
+/**   "C8TR" u8 version                                      **/
+/**   block*: u32 records, u32 bytes, u64 baseCycle, payload **/
+/** Each record in a payload is encoded against the previous **/
+/** one in the same block, see Chip8Trace.cpp for details.   **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "Chip8.h"
+#include "SpscRing.h"
+
+///One executed instruction. PC and opcode are the values before execution,
+///everything else is the machine state after it.
+struct TraceRecord
+{
+  uint64_t cycle;
+  uint16_t pc;
+  uint16_t opcode;
+  uint16_t I;
+  int16_t SP;
+  uint8_t DT, ST;
+  uint8_t V[16];
+
+  ///Memory written by the instruction (only Fx33 and Fx55 write memory).
+  uint16_t memAddr;
+  uint8_t memLen;
+  uint8_t mem[16];
+};
+
+class Chip8Tracer
+{
+public:
+  Chip8Tracer();
+  ~Chip8Tracer();
+
+  ///Opens the trace file and starts the writer thread.
+  bool start(const char *path);
+
+  ///Stops tracing, drains the ring and closes the file.
+  void stop();
+
+  bool is_active() const { return active.load(std::memory_order_relaxed); }
+
+  ///Called by the core thread around Chip8::step(). after_step() must only be
+  ///called when before_step() returned true.
+  bool before_step(const Chip8 &chip);
+  void after_step(const Chip8 &chip);
+
+  uint64_t records_written() const { return recordsWritten.load(std::memory_order_relaxed); }
+  uint64_t bytes_written() const { return bytesWritten.load(std::memory_order_relaxed); }
+
+  ///Number of times the core had to wait for the writer because the ring was full.
+  uint64_t stalls() const { return producerStalls.load(std::memory_order_relaxed); }
+
+private:
+  SpscRing<TraceRecord> ring;
+  std::thread writer;
+  FILE *file = NULL;
+
+  std::atomic<bool> active{false};
+  std::atomic<bool> inStep{false};
+  std::atomic<bool> running{false};
+
+  std::atomic<uint64_t> recordsWritten{0};
+  std::atomic<uint64_t> bytesWritten{0};
+  std::atomic<uint64_t> producerStalls{0};
+
+  //State captured by before_step(), only touched by the core thread.
+  TraceRecord pending;
+
+  void writer_loop();
+};
+
+///Decodes a trace file written by Chip8Tracer.
+class Chip8TraceReader
+{
+public:
+  ~Chip8TraceReader();
+
+  bool open(const char *path);
+  void close();
+
+  ///Reads the next record. Returns false at the end of the file or on a corrupt block.
+  bool next(TraceRecord &record);
+
+private:
+  FILE *file = NULL;
+  std::vector<uint8_t> block;
+  size_t blockPos = 0;
+  uint32_t blockRecords = 0;
+
+  TraceRecord prev;
+  uint16_t opcodeCache[4096];
+
+  bool read_block();
+};
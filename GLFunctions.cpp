@@ -0,0 +1,168 @@
+#include "GLFunctions.h"
+#include <SDL.h>
+#include <iostream>
+
+namespace gl
+{
+	PFNGLACTIVETEXTUREPROC ActiveTexture;
+
+	PFNGLGENBUFFERSPROC GenBuffers;
+	PFNGLDELETEBUFFERSPROC DeleteBuffers;
+	PFNGLBINDBUFFERPROC BindBuffer;
+	PFNGLBUFFERDATAPROC BufferData;
+	PFNGLMAPBUFFERPROC MapBuffer;
+	PFNGLUNMAPBUFFERPROC UnmapBuffer;
+	PFNGLBUFFERSUBDATAPROC BufferSubData;
+
+	PFNGLCREATESHADERPROC CreateShader;
+	PFNGLDELETESHADERPROC DeleteShader;
+	PFNGLSHADERSOURCEPROC ShaderSource;
+	PFNGLCOMPILESHADERPROC CompileShader;
+	PFNGLGETSHADERIVPROC GetShaderiv;
+	PFNGLGETSHADERINFOLOGPROC GetShaderInfoLog;
+	PFNGLCREATEPROGRAMPROC CreateProgram;
+	PFNGLDELETEPROGRAMPROC DeleteProgram;
+	PFNGLATTACHSHADERPROC AttachShader;
+	PFNGLLINKPROGRAMPROC LinkProgram;
+	PFNGLGETPROGRAMIVPROC GetProgramiv;
+	PFNGLGETPROGRAMINFOLOGPROC GetProgramInfoLog;
+	PFNGLUSEPROGRAMPROC UseProgram;
+	PFNGLGETUNIFORMLOCATIONPROC GetUniformLocation;
+	PFNGLUNIFORM1IPROC Uniform1i;
+	PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv;
+	PFNGLGETATTRIBLOCATIONPROC GetAttribLocation;
+	PFNGLENABLEVERTEXATTRIBARRAYPROC EnableVertexAttribArray;
+	PFNGLVERTEXATTRIBPOINTERPROC VertexAttribPointer;
+
+	PFNGLGENVERTEXARRAYSPROC GenVertexArrays;
+	PFNGLDELETEVERTEXARRAYSPROC DeleteVertexArrays;
+	PFNGLBINDVERTEXARRAYPROC BindVertexArray;
+	PFNGLDRAWELEMENTSBASEVERTEXPROC DrawElementsBaseVertex;
+
+	template <typename T>
+	static void lookup(T& function, const char* name)
+	{
+		function = (T)SDL_GL_GetProcAddress(name);
+	}
+
+	void load()
+	{
+		lookup(ActiveTexture, "glActiveTexture");
+
+		lookup(GenBuffers, "glGenBuffers");
+		lookup(DeleteBuffers, "glDeleteBuffers");
+		lookup(BindBuffer, "glBindBuffer");
+		lookup(BufferData, "glBufferData");
+		lookup(MapBuffer, "glMapBuffer");
+		lookup(UnmapBuffer, "glUnmapBuffer");
+		lookup(BufferSubData, "glBufferSubData");
+
+		lookup(CreateShader, "glCreateShader");
+		lookup(DeleteShader, "glDeleteShader");
+		lookup(ShaderSource, "glShaderSource");
+		lookup(CompileShader, "glCompileShader");
+		lookup(GetShaderiv, "glGetShaderiv");
+		lookup(GetShaderInfoLog, "glGetShaderInfoLog");
+		lookup(CreateProgram, "glCreateProgram");
+		lookup(DeleteProgram, "glDeleteProgram");
+		lookup(AttachShader, "glAttachShader");
+		lookup(LinkProgram, "glLinkProgram");
+		lookup(GetProgramiv, "glGetProgramiv");
+		lookup(GetProgramInfoLog, "glGetProgramInfoLog");
+		lookup(UseProgram, "glUseProgram");
+		lookup(GetUniformLocation, "glGetUniformLocation");
+		lookup(Uniform1i, "glUniform1i");
+		lookup(UniformMatrix4fv, "glUniformMatrix4fv");
+		lookup(GetAttribLocation, "glGetAttribLocation");
+		lookup(EnableVertexAttribArray, "glEnableVertexAttribArray");
+		lookup(VertexAttribPointer, "glVertexAttribPointer");
+
+		lookup(GenVertexArrays, "glGenVertexArrays");
+		lookup(DeleteVertexArrays, "glDeleteVertexArrays");
+		lookup(BindVertexArray, "glBindVertexArray");
+		lookup(DrawElementsBaseVertex, "glDrawElementsBaseVertex");
+	}
+
+	bool has_buffers()
+	{
+		return GenBuffers && DeleteBuffers && BindBuffer && BufferData && MapBuffer && UnmapBuffer;
+	}
+
+	bool has_shaders()
+	{
+		return ActiveTexture && CreateShader && DeleteShader && ShaderSource && CompileShader &&
+			GetShaderiv && GetShaderInfoLog && CreateProgram && DeleteProgram && AttachShader &&
+			LinkProgram && GetProgramiv && GetProgramInfoLog && UseProgram && GetUniformLocation &&
+			Uniform1i;
+	}
+
+	bool has_gl3()
+	{
+		return has_buffers() && has_shaders() && BufferSubData && UniformMatrix4fv &&
+			GetAttribLocation && EnableVertexAttribArray && VertexAttribPointer && GenVertexArrays &&
+			DeleteVertexArrays && BindVertexArray && DrawElementsBaseVertex;
+	}
+
+	static GLuint compile_shader(GLenum type, const char* source)
+	{
+		GLuint shader = CreateShader(type);
+		ShaderSource(shader, 1, &source, NULL);
+		CompileShader(shader);
+
+		GLint compiled = 0;
+		GetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+		if (!compiled)
+		{
+			char log[1024];
+			GetShaderInfoLog(shader, sizeof(log), NULL, log);
+			std::cout << "Error compiling shader: " << log << std::endl;
+			DeleteShader(shader);
+			return 0;
+		}
+
+		return shader;
+	}
+
+	GLuint build_program(const char* vertexSource, const char* fragmentSource)
+	{
+		if (!has_shaders())
+			return 0;
+
+		GLuint vertex = vertexSource ? compile_shader(GL_VERTEX_SHADER, vertexSource) : 0;
+		GLuint fragment = fragmentSource ? compile_shader(GL_FRAGMENT_SHADER, fragmentSource) : 0;
+		if ((vertexSource && !vertex) || (fragmentSource && !fragment))
+		{
+			if (vertex)
+				DeleteShader(vertex);
+			if (fragment)
+				DeleteShader(fragment);
+			return 0;
+		}
+
+		GLuint program = CreateProgram();
+		if (vertex)
+			AttachShader(program, vertex);
+		if (fragment)
+			AttachShader(program, fragment);
+		LinkProgram(program);
+
+		//The program keeps the shaders alive for as long as it needs them.
+		if (vertex)
+			DeleteShader(vertex);
+		if (fragment)
+			DeleteShader(fragment);
+
+		GLint linked = 0;
+		GetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked)
+		{
+			char log[1024];
+			GetProgramInfoLog(program, sizeof(log), NULL, log);
+			std::cout << "Error linking program: " << log << std::endl;
+			DeleteProgram(program);
+			return 0;
+		}
+
+		return program;
+	}
+}
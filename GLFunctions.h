@@ -0,0 +1,66 @@
+/** OpenGL entry points newer than 1.1, looked up at run time **/
+
+#pragma once
+#include <SDL_opengl.h>
+
+//Windows only exports OpenGL 1.1 from opengl32.dll, so everything newer has to
+//be fetched from the driver once a context exists. The pointers live in their
+//own namespace so they don't clash with prototypes other headers may declare.
+namespace gl
+{
+	//Multitexture (1.3)
+	extern PFNGLACTIVETEXTUREPROC ActiveTexture;
+
+	//Buffer objects (1.5)
+	extern PFNGLGENBUFFERSPROC GenBuffers;
+	extern PFNGLDELETEBUFFERSPROC DeleteBuffers;
+	extern PFNGLBINDBUFFERPROC BindBuffer;
+	extern PFNGLBUFFERDATAPROC BufferData;
+	extern PFNGLMAPBUFFERPROC MapBuffer;
+	extern PFNGLUNMAPBUFFERPROC UnmapBuffer;
+	extern PFNGLBUFFERSUBDATAPROC BufferSubData;
+
+	//Shaders (2.0)
+	extern PFNGLCREATESHADERPROC CreateShader;
+	extern PFNGLDELETESHADERPROC DeleteShader;
+	extern PFNGLSHADERSOURCEPROC ShaderSource;
+	extern PFNGLCOMPILESHADERPROC CompileShader;
+	extern PFNGLGETSHADERIVPROC GetShaderiv;
+	extern PFNGLGETSHADERINFOLOGPROC GetShaderInfoLog;
+	extern PFNGLCREATEPROGRAMPROC CreateProgram;
+	extern PFNGLDELETEPROGRAMPROC DeleteProgram;
+	extern PFNGLATTACHSHADERPROC AttachShader;
+	extern PFNGLLINKPROGRAMPROC LinkProgram;
+	extern PFNGLGETPROGRAMIVPROC GetProgramiv;
+	extern PFNGLGETPROGRAMINFOLOGPROC GetProgramInfoLog;
+	extern PFNGLUSEPROGRAMPROC UseProgram;
+	extern PFNGLGETUNIFORMLOCATIONPROC GetUniformLocation;
+	extern PFNGLUNIFORM1IPROC Uniform1i;
+	extern PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv;
+	extern PFNGLGETATTRIBLOCATIONPROC GetAttribLocation;
+	extern PFNGLENABLEVERTEXATTRIBARRAYPROC EnableVertexAttribArray;
+	extern PFNGLVERTEXATTRIBPOINTERPROC VertexAttribPointer;
+
+	//Vertex arrays (3.0) and base vertex draws (3.2)
+	extern PFNGLGENVERTEXARRAYSPROC GenVertexArrays;
+	extern PFNGLDELETEVERTEXARRAYSPROC DeleteVertexArrays;
+	extern PFNGLBINDVERTEXARRAYPROC BindVertexArray;
+	extern PFNGLDRAWELEMENTSBASEVERTEXPROC DrawElementsBaseVertex;
+
+	//Looks up all the entry points for the current context. Pointers from one
+	//context aren't valid in another, so call it again after making a new one current.
+	void load();
+
+	//Whether pixel buffer objects can be used.
+	bool has_buffers();
+
+	//Whether GLSL programs can be used.
+	bool has_shaders();
+
+	//Whether everything the OpenGL 3 core profile renderer needs is there.
+	bool has_gl3();
+
+	//Compiles and links a program. A NULL source leaves that stage to the fixed
+	//function pipeline. Returns 0, after printing the log, on failure.
+	GLuint build_program(const char* vertexSource, const char* fragmentSource);
+}
@@ -0,0 +1,134 @@
+/** A fixed size, lock-free ring buffer for exactly one     **/
+/** producer thread and one consumer thread.                 **/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+template <typename T>
+class SpscRing
+{
+private:
+  std::vector<T> slots;
+  size_t mask;
+
+  //The indices only ever increase and are masked on access. Each lives on its
+  //own cache line so the producer and consumer don't fight over it.
+  //Each side also keeps a private copy of the other side's index and only
+  //reloads it when the copy says the ring is full (or empty).
+  alignas(64) std::atomic<size_t> head{0}; //Next slot to write, owned by the producer.
+  size_t cachedTail = 0;
+  alignas(64) std::atomic<size_t> tail{0}; //Next slot to read, owned by the consumer.
+  size_t cachedHead = 0;
+
+public:
+  ///Capacity is rounded up to a power of two.
+  explicit SpscRing(size_t capacity)
+  {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+
+    slots.resize(size);
+    mask = size - 1;
+  }
+
+  size_t capacity() const { return slots.size(); }
+
+  ///Number of items waiting. Exact only when called from one of the two threads.
+  size_t size() const
+  {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+
+  bool empty() const { return size() == 0; }
+
+  ///Producer side. Returns false if the ring is full.
+  bool push(const T &item)
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - cachedTail == slots.size())
+    {
+      cachedTail = tail.load(std::memory_order_acquire);
+      if (h - cachedTail == slots.size())
+        return false;
+    }
+
+    slots[h & mask] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  ///Consumer side. Returns false if the ring is empty.
+  bool pop(T &item)
+  {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t == cachedHead)
+    {
+      cachedHead = head.load(std::memory_order_acquire);
+      if (t == cachedHead)
+        return false;
+    }
+
+    item = slots[t & mask];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  ///Producer side. Copies up to count items in and returns how many fit.
+  size_t write(const T *items, size_t count)
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    cachedTail = tail.load(std::memory_order_acquire);
+
+    size_t space = slots.size() - (h - cachedTail);
+    if (count > space)
+      count = space;
+
+    for (size_t i = 0; i < count; i++)
+      slots[(h + i) & mask] = items[i];
+
+    head.store(h + count, std::memory_order_release);
+    return count;
+  }
+
+  ///Consumer side. Copies up to count items out and returns how many there were.
+  size_t read(T *items, size_t count)
+  {
+    size_t t = tail.load(std::memory_order_relaxed);
+    cachedHead = head.load(std::memory_order_acquire);
+
+    size_t available = cachedHead - t;
+    if (count > available)
+      count = available;
+
+    for (size_t i = 0; i < count; i++)
+      items[i] = slots[(t + i) & mask];
+
+    tail.store(t + count, std::memory_order_release);
+    return count;
+  }
+
+  ///Consumer side. Returns the oldest item without removing it, or NULL.
+  const T *peek()
+  {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t == cachedHead)
+    {
+      cachedHead = head.load(std::memory_order_acquire);
+      if (t == cachedHead)
+        return nullptr;
+    }
+
+    return &slots[t & mask];
+  }
+
+  ///Consumer side. Drops everything currently queued.
+  void clear()
+  {
+    cachedHead = head.load(std::memory_order_acquire);
+    tail.store(cachedHead, std::memory_order_release);
+  }
+};
@@ -0,0 +1,60 @@
+/** Lock-free triple buffer for handing complete frames     **/
+/** from one producer thread to one consumer thread. The    **/
+/** producer never waits, and the consumer always gets the  **/
+/** most recently published frame.                          **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+template <typename T>
+class TripleBuffer
+{
+private:
+  //Each buffer sits on its own cache line(s) so writes to the back buffer
+  //never invalidate the line the consumer is reading from.
+  struct alignas(64) Slot
+  {
+    T data;
+  };
+
+  static constexpr uint8_t INDEX_MASK = 0x3;
+  static constexpr uint8_t DIRTY = 0x4;
+
+  Slot slots[3];
+
+  //Index of the middle buffer, plus DIRTY when it holds a frame the consumer
+  //hasn't taken yet. This is the only state shared between the two threads.
+  alignas(64) std::atomic<uint8_t> middle{1};
+
+  alignas(64) uint8_t backIndex = 0; //Owned by the producer.
+  alignas(64) uint8_t frontIndex = 2; //Owned by the consumer.
+
+public:
+  ///Producer side. The buffer to fill with the next frame.
+  T &back() { return slots[backIndex].data; }
+
+  ///Producer side. Makes the back buffer the latest frame and takes the old
+  ///middle buffer as the new back buffer.
+  void publish()
+  {
+    uint8_t prev = middle.exchange(backIndex | DIRTY, std::memory_order_acq_rel);
+    backIndex = prev & INDEX_MASK;
+  }
+
+  ///Consumer side. Swaps in the latest frame if one was published since the
+  ///last call. Returns false if front() is already the latest.
+  bool acquire()
+  {
+    if (!(middle.load(std::memory_order_relaxed) & DIRTY))
+      return false;
+
+    uint8_t prev = middle.exchange(frontIndex, std::memory_order_acq_rel);
+    frontIndex = prev & INDEX_MASK;
+    return true;
+  }
+
+  ///Consumer side. The frame taken by the last successful acquire().
+  const T &front() const { return slots[frontIndex].data; }
+};
@@ -10,11 +10,15 @@ IF "%1" == "release" (
     set OPT_FLAG=/Zi
     )
 
+@REM Add /DCHIP8_STATS to collect opcode, PC, skip and DRW counters.
+set DEFINES=
+
 set OUT_EXE=chip8.exe
 set SDL2_DIR=E:\Projects\SDL\SDL2-devel-2.0.9-VC\SDL2-2.0.9
 set INCLUDES=/I.. /I..\.. /I%SDL2_DIR%\include
-set SOURCES=main.cpp Chip8.cpp Chip8Sound.cpp CTexture.cpp .\imgui\imgui_impl_sdl.cpp .\imgui\imgui_impl_opengl2.cpp .\imgui\imgui*.cpp
+set SOURCES=main.cpp Chip8.cpp Chip8Stats.cpp Chip8Input.cpp Chip8Profiler.cpp Chip8Trace.cpp Chip8Sound.cpp Chip8Synth.cpp Chip8Phosphor.cpp Chip8Scaler.cpp Chip8Grid.cpp Chip8Pacer.cpp Chip8Commands.cpp Chip8RomLoader.cpp AudioSink.cpp CTexture.cpp CDisplayTexture.cpp CDisplayAtlas.cpp GLFunctions.cpp .\imgui\imgui_impl_sdl.cpp .\imgui\imgui_impl_opengl2.cpp .\imgui\imgui_impl_opengl3.cpp .\imgui\imgui_impl_soft.cpp .\imgui\imgui*.cpp
 set LIBS=/libpath:%SDL2_DIR%\lib\x64 SDL2.lib SDL2main.lib opengl32.lib
 mkdir %OUT_DIR%
-cl /EHsc /std:c++17 /nologo %OPT_FLAG% /MD %INCLUDES% %SOURCES% /Fe%OUT_DIR%/chip8.exe /Fo%OUT_DIR%/ /link %LIBS% /subsystem:console
+cl /EHsc /std:c++17 /nologo %OPT_FLAG% %DEFINES% /MD %INCLUDES% %SOURCES% /Fe%OUT_DIR%/chip8.exe /Fo%OUT_DIR%/ /link %LIBS% /subsystem:console
+cl /EHsc /std:c++17 /nologo %OPT_FLAG% /MD /I. trace_reader.cpp Chip8Trace.cpp /Fe%OUT_DIR%/trace_reader.exe /Fo%OUT_DIR%/
 cp SDL2.dll %OUT_DIR%
\ No newline at end of file
@@ -0,0 +1,31 @@
+// dear imgui: Renderer for OpenGL3 core profile
+// This needs to be used along with a Platform Binding (e.g. GLFW, SDL, Win32, custom..)
+
+// Implemented features:
+//  [X] Renderer: User texture binding. Use 'GLuint' OpenGL texture identifier as void*/ImTextureID. Read the FAQ about ImTextureID in imgui.cpp.
+//  [X] Renderer: Palette indexed images, switched on from draw callbacks with ImGui_ImplOpenGL3_SetPalette().
+
+// Written for this emulator rather than taken from the imgui examples. All the
+// vertices and indices of a frame go into one orphaned VBO/IBO pair and are drawn
+// with a single shader. The state it needs is set at the start of every frame and
+// tracked on the CPU afterwards: nothing is queried from GL and nothing is
+// restored, so callers must not expect GL state to survive RenderDrawData().
+// Needs an OpenGL 3.2 core profile context and the entry points in GLFunctions.h.
+
+#pragma once
+
+IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_Init();
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_Shutdown();
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_NewFrame();
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data);
+
+// For use from draw callbacks: textures drawn after this call hold palette indices
+// in their red channel and are coloured through the given 16x1 RGBA palette
+// texture. Pass 0 to go back to plain textures.
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_SetPalette(unsigned int palette_texture);
+
+// Called by Init/NewFrame/Shutdown
+IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_CreateFontsTexture();
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyFontsTexture();
+IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_CreateDeviceObjects();
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyDeviceObjects();
@@ -0,0 +1,42 @@
+// dear imgui: Software renderer, no GPU or OpenGL needed
+// This needs to be used along with a Platform Binding (e.g. GLFW, SDL, Win32, custom..)
+
+// Implemented features:
+//  [X] Renderer: User texture binding. Use a 'SoftTexture*' as ImTextureID.
+//  [X] Renderer: Palette indexed user textures.
+
+// Written for this emulator. Draw lists are rasterised on the CPU into any
+// 32-bit XRGB8888 framebuffer (e.g. an SDL surface). Axis aligned rectangles,
+// which are most of what ImGui draws, are filled a span at a time with SSE2
+// where available; everything else goes through a general triangle rasteriser
+// with colour and texture coordinate interpolation. Sampling is nearest texel,
+// and the output only depends on the draw data, so screenshots are repeatable.
+
+#pragma once
+
+#include <stdint.h>
+
+// A texture the software renderer can sample. Pixels are not copied, so they
+// must stay valid until the frame is drawn.
+struct SoftTexture
+{
+    enum Format
+    {
+        ALPHA8,     // One byte of coverage per texel, coloured white (the font atlas)
+        RGBA32,     // Four bytes per texel, R first in memory
+        INDEXED8    // One byte per texel, looked up in 'palette'
+    };
+
+    Format          format;
+    int             width;
+    int             height;
+    const void*     pixels;
+    const uint32_t* palette;    // INDEXED8 only: colours packed like IM_COL32(), one for every index used
+};
+
+IMGUI_IMPL_API bool     ImGui_ImplSoft_Init();
+IMGUI_IMPL_API void     ImGui_ImplSoft_Shutdown();
+IMGUI_IMPL_API void     ImGui_ImplSoft_NewFrame();
+
+// Draws into a framebuffer of 0x00RRGGBB pixels. 'pitch' is in bytes.
+IMGUI_IMPL_API void     ImGui_ImplSoft_RenderDrawData(ImDrawData* draw_data, void* pixels, int width, int height, int pitch);
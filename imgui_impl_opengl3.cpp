@@ -0,0 +1,279 @@
+// dear imgui: Renderer for OpenGL3 core profile
+// This needs to be used along with a Platform Binding (e.g. GLFW, SDL, Win32, custom..)
+
+// Implemented features:
+//  [X] Renderer: User texture binding. Use 'GLuint' OpenGL texture identifier as void*/ImTextureID. Read the FAQ about ImTextureID in imgui.cpp.
+//  [X] Renderer: Palette indexed images, switched on from draw callbacks with ImGui_ImplOpenGL3_SetPalette().
+
+// See imgui_impl_opengl3.h for how this differs from the imgui example renderer.
+
+#include "imgui.h"
+#include "imgui_impl_opengl3.h"
+#include "GLFunctions.h"
+#include <stdint.h>     // intptr_t
+
+// OpenGL Data
+static GLuint       g_FontTexture = 0;
+static GLuint       g_ShaderHandle = 0;
+static GLint        g_UniformLocationProjMtx = 0, g_UniformLocationUsePalette = 0;
+static GLuint       g_VaoHandle = 0, g_VboHandle = 0, g_ElementsHandle = 0;
+
+// State tracked on the CPU while a frame is being drawn
+static GLuint       g_BoundTexture = 0;
+static GLuint       g_BoundPalette = 0;
+
+static const char* g_VertexShader =
+    "#version 150\n"
+    "uniform mat4 ProjMtx;\n"
+    "in vec2 Position;\n"
+    "in vec2 UV;\n"
+    "in vec4 Color;\n"
+    "out vec2 Frag_UV;\n"
+    "out vec4 Frag_Color;\n"
+    "void main()\n"
+    "{\n"
+    "    Frag_UV = UV;\n"
+    "    Frag_Color = Color;\n"
+    "    gl_Position = ProjMtx * vec4(Position.xy, 0, 1);\n"
+    "}\n";
+
+static const char* g_FragmentShader =
+    "#version 150\n"
+    "uniform sampler2D Texture;\n"
+    "uniform sampler2D Palette;\n"
+    "uniform bool UsePalette;\n"
+    "in vec2 Frag_UV;\n"
+    "in vec4 Frag_Color;\n"
+    "out vec4 Out_Color;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 texel = texture(Texture, Frag_UV.st);\n"
+    "    if (UsePalette)\n"
+    "        texel = texture(Palette, vec2((floor(texel.r * 255.0 + 0.5) + 0.5) / 16.0, 0.5));\n"
+    "    Out_Color = Frag_Color * texel;\n"
+    "}\n";
+
+// Functions
+bool    ImGui_ImplOpenGL3_Init()
+{
+    ImGuiIO& io = ImGui::GetIO();
+    io.BackendRendererName = "imgui_impl_opengl3";
+
+    // Built straight away so a context or shader problem shows up here, where
+    // the caller can still fall back to another renderer.
+    return gl::has_gl3() && ImGui_ImplOpenGL3_CreateDeviceObjects();
+}
+
+void    ImGui_ImplOpenGL3_Shutdown()
+{
+    ImGui_ImplOpenGL3_DestroyDeviceObjects();
+}
+
+void    ImGui_ImplOpenGL3_NewFrame()
+{
+    if (!g_FontTexture)
+        ImGui_ImplOpenGL3_CreateDeviceObjects();
+}
+
+void    ImGui_ImplOpenGL3_SetPalette(unsigned int palette_texture)
+{
+    if (palette_texture == g_BoundPalette)
+        return;
+
+    if (palette_texture != 0)
+    {
+        gl::ActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, palette_texture);
+        gl::ActiveTexture(GL_TEXTURE0);
+    }
+    if ((palette_texture != 0) != (g_BoundPalette != 0))
+        gl::Uniform1i(g_UniformLocationUsePalette, palette_texture != 0);
+    g_BoundPalette = palette_texture;
+}
+
+// OpenGL3 Render function.
+void ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
+{
+    // Avoid rendering when minimized, scale coordinates for retina displays (screen coordinates != framebuffer coordinates)
+    ImGuiIO& io = ImGui::GetIO();
+    int fb_width = (int)(draw_data->DisplaySize.x * io.DisplayFramebufferScale.x);
+    int fb_height = (int)(draw_data->DisplaySize.y * io.DisplayFramebufferScale.y);
+    if (fb_width == 0 || fb_height == 0 || draw_data->TotalVtxCount == 0)
+        return;
+    draw_data->ScaleClipRects(io.DisplayFramebufferScale);
+
+    // Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled.
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_SCISSOR_TEST);
+
+    // Setup viewport, orthographic projection matrix
+    glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
+    float L = draw_data->DisplayPos.x;
+    float R = draw_data->DisplayPos.x + draw_data->DisplaySize.x;
+    float T = draw_data->DisplayPos.y;
+    float B = draw_data->DisplayPos.y + draw_data->DisplaySize.y;
+    const float ortho_projection[4][4] =
+    {
+        { 2.0f/(R-L),   0.0f,         0.0f,   0.0f },
+        { 0.0f,         2.0f/(T-B),   0.0f,   0.0f },
+        { 0.0f,         0.0f,        -1.0f,   0.0f },
+        { (R+L)/(L-R),  (T+B)/(B-T),  0.0f,   1.0f },
+    };
+    gl::UseProgram(g_ShaderHandle);
+    gl::UniformMatrix4fv(g_UniformLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
+    gl::Uniform1i(g_UniformLocationUsePalette, 0);
+    gl::BindVertexArray(g_VaoHandle);
+    gl::BindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
+
+    // Anything may have been bound since the last frame.
+    g_BoundTexture = 0;
+    g_BoundPalette = 0;
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Upload the whole frame at once. Dropping the old storage first means the
+    // driver never has to wait for the previous frame's draws to finish.
+    gl::BufferData(GL_ARRAY_BUFFER, (GLsizeiptr)draw_data->TotalVtxCount * sizeof(ImDrawVert), NULL, GL_STREAM_DRAW);
+    gl::BufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)draw_data->TotalIdxCount * sizeof(ImDrawIdx), NULL, GL_STREAM_DRAW);
+    int vtx_offset = 0;
+    int idx_offset = 0;
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        gl::BufferSubData(GL_ARRAY_BUFFER, (GLintptr)vtx_offset * sizeof(ImDrawVert), (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), cmd_list->VtxBuffer.Data);
+        gl::BufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)idx_offset * sizeof(ImDrawIdx), (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), cmd_list->IdxBuffer.Data);
+        vtx_offset += cmd_list->VtxBuffer.Size;
+        idx_offset += cmd_list->IdxBuffer.Size;
+    }
+
+    // Render command lists
+    ImVec2 pos = draw_data->DisplayPos;
+    vtx_offset = 0;
+    idx_offset = 0;
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        int list_idx_offset = idx_offset;
+
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+        {
+            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+            if (pcmd->UserCallback)
+            {
+                // User callback (registered via ImDrawList::AddCallback)
+                pcmd->UserCallback(cmd_list, pcmd);
+            }
+            else
+            {
+                ImVec4 clip_rect = ImVec4(pcmd->ClipRect.x - pos.x, pcmd->ClipRect.y - pos.y, pcmd->ClipRect.z - pos.x, pcmd->ClipRect.w - pos.y);
+                if (clip_rect.x < fb_width && clip_rect.y < fb_height && clip_rect.z >= 0.0f && clip_rect.w >= 0.0f)
+                {
+                    // Apply scissor/clipping rectangle
+                    glScissor((int)clip_rect.x, (int)(fb_height - clip_rect.w), (int)(clip_rect.z - clip_rect.x), (int)(clip_rect.w - clip_rect.y));
+
+                    // Bind texture, Draw
+                    GLuint texture = (GLuint)(intptr_t)pcmd->TextureId;
+                    if (texture != g_BoundTexture)
+                    {
+                        glBindTexture(GL_TEXTURE_2D, texture);
+                        g_BoundTexture = texture;
+                    }
+                    gl::DrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                        (void*)((intptr_t)list_idx_offset * sizeof(ImDrawIdx)), vtx_offset);
+                }
+            }
+            list_idx_offset += pcmd->ElemCount;
+        }
+
+        vtx_offset += cmd_list->VtxBuffer.Size;
+        idx_offset += cmd_list->IdxBuffer.Size;
+    }
+
+    // Left on, the scissor would clip the next frame's glClear.
+    glDisable(GL_SCISSOR_TEST);
+}
+
+bool ImGui_ImplOpenGL3_CreateFontsTexture()
+{
+    // Build texture atlas
+    ImGuiIO& io = ImGui::GetIO();
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    // Upload texture to graphics system
+    glGenTextures(1, &g_FontTexture);
+    glBindTexture(GL_TEXTURE_2D, g_FontTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Store our identifier
+    io.Fonts->TexID = (ImTextureID)(intptr_t)g_FontTexture;
+
+    return true;
+}
+
+void ImGui_ImplOpenGL3_DestroyFontsTexture()
+{
+    if (g_FontTexture)
+    {
+        ImGuiIO& io = ImGui::GetIO();
+        glDeleteTextures(1, &g_FontTexture);
+        io.Fonts->TexID = 0;
+        g_FontTexture = 0;
+    }
+}
+
+bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
+{
+    g_ShaderHandle = gl::build_program(g_VertexShader, g_FragmentShader);
+    if (g_ShaderHandle == 0)
+        return false;
+
+    g_UniformLocationProjMtx = gl::GetUniformLocation(g_ShaderHandle, "ProjMtx");
+    g_UniformLocationUsePalette = gl::GetUniformLocation(g_ShaderHandle, "UsePalette");
+    GLint attrib_location_position = gl::GetAttribLocation(g_ShaderHandle, "Position");
+    GLint attrib_location_uv = gl::GetAttribLocation(g_ShaderHandle, "UV");
+    GLint attrib_location_color = gl::GetAttribLocation(g_ShaderHandle, "Color");
+
+    // The samplers always read from the same units.
+    gl::UseProgram(g_ShaderHandle);
+    gl::Uniform1i(gl::GetUniformLocation(g_ShaderHandle, "Texture"), 0);
+    gl::Uniform1i(gl::GetUniformLocation(g_ShaderHandle, "Palette"), 1);
+    gl::UseProgram(0);
+
+    // The vertex layout never changes, so it is recorded once in a VAO.
+    gl::GenVertexArrays(1, &g_VaoHandle);
+    gl::GenBuffers(1, &g_VboHandle);
+    gl::GenBuffers(1, &g_ElementsHandle);
+    gl::BindVertexArray(g_VaoHandle);
+    gl::BindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
+    gl::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
+    gl::EnableVertexAttribArray(attrib_location_position);
+    gl::EnableVertexAttribArray(attrib_location_uv);
+    gl::EnableVertexAttribArray(attrib_location_color);
+    gl::VertexAttribPointer(attrib_location_position, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, pos));
+    gl::VertexAttribPointer(attrib_location_uv, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, uv));
+    gl::VertexAttribPointer(attrib_location_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, col));
+    gl::BindVertexArray(0);
+
+    return ImGui_ImplOpenGL3_CreateFontsTexture();
+}
+
+void    ImGui_ImplOpenGL3_DestroyDeviceObjects()
+{
+    if (g_VaoHandle) gl::DeleteVertexArrays(1, &g_VaoHandle);
+    if (g_VboHandle) gl::DeleteBuffers(1, &g_VboHandle);
+    if (g_ElementsHandle) gl::DeleteBuffers(1, &g_ElementsHandle);
+    g_VaoHandle = g_VboHandle = g_ElementsHandle = 0;
+
+    if (g_ShaderHandle) gl::DeleteProgram(g_ShaderHandle);
+    g_ShaderHandle = 0;
+
+    ImGui_ImplOpenGL3_DestroyFontsTexture();
+}
@@ -0,0 +1,369 @@
+// dear imgui: Software renderer, no GPU or OpenGL needed
+// This needs to be used along with a Platform Binding (e.g. GLFW, SDL, Win32, custom..)
+
+// Implemented features:
+//  [X] Renderer: User texture binding. Use a 'SoftTexture*' as ImTextureID.
+//  [X] Renderer: Palette indexed user textures.
+
+// See imgui_impl_soft.h for an overview.
+
+#include "imgui.h"
+#include "imgui_impl_soft.h"
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMGUI_SOFT_SSE2
+#include <emmintrin.h>
+#endif
+
+// Data
+static SoftTexture  g_FontTexture;
+static bool         g_FontTextureReady = false;
+
+// The part of the framebuffer the current command may touch.
+struct SoftTarget
+{
+    uint32_t*   pixels;
+    int         stride;     // In pixels
+    int         x0, y0, x1, y1;
+};
+
+// Functions
+bool    ImGui_ImplSoft_Init()
+{
+    ImGuiIO& io = ImGui::GetIO();
+    io.BackendRendererName = "imgui_impl_soft";
+    return true;
+}
+
+void    ImGui_ImplSoft_Shutdown()
+{
+    ImGuiIO& io = ImGui::GetIO();
+    io.Fonts->TexID = 0;
+    g_FontTextureReady = false;
+}
+
+void    ImGui_ImplSoft_NewFrame()
+{
+    if (g_FontTextureReady)
+        return;
+
+    // The atlas owns the pixels, so the texture only has to point at them.
+    ImGuiIO& io = ImGui::GetIO();
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsAlpha8(&pixels, &width, &height);
+    g_FontTexture.format = SoftTexture::ALPHA8;
+    g_FontTexture.width = width;
+    g_FontTexture.height = height;
+    g_FontTexture.pixels = pixels;
+    g_FontTexture.palette = NULL;
+    io.Fonts->TexID = (ImTextureID)&g_FontTexture;
+    g_FontTextureReady = true;
+}
+
+template<typename T> static inline T Min(T a, T b) { return a < b ? a : b; }
+template<typename T> static inline T Max(T a, T b) { return a < b ? b : a; }
+
+// x / 255 rounded, for x up to 255 * 255 + 255. The SSE2 path uses the same
+// formula so both give identical pixels.
+static inline uint32_t Div255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// Multiplies two IM_COL32 colours channel by channel.
+static inline ImU32 Modulate(ImU32 a, ImU32 b)
+{
+    if (b == 0xffffffff)
+        return a;
+    uint32_t r = Div255((a & 0xff) * (b & 0xff));
+    uint32_t g = Div255(((a >> 8) & 0xff) * ((b >> 8) & 0xff));
+    uint32_t bl = Div255(((a >> 16) & 0xff) * ((b >> 16) & 0xff));
+    uint32_t al = Div255((a >> 24) * (b >> 24));
+    return r | (g << 8) | (bl << 16) | (al << 24);
+}
+
+// Blends an IM_COL32 colour over an XRGB8888 pixel.
+static inline uint32_t Blend(uint32_t dst, ImU32 src)
+{
+    uint32_t a = src >> 24;
+    uint32_t sr = src & 0xff, sg = (src >> 8) & 0xff, sb = (src >> 16) & 0xff;
+    if (a == 255)
+        return (sr << 16) | (sg << 8) | sb;
+    uint32_t ia = 255 - a;
+    uint32_t r = Div255(sr * a + ((dst >> 16) & 0xff) * ia);
+    uint32_t g = Div255(sg * a + ((dst >> 8) & 0xff) * ia);
+    uint32_t b = Div255(sb * a + (dst & 0xff) * ia);
+    return (r << 16) | (g << 8) | b;
+}
+
+static inline ImU32 Sample(const SoftTexture* tex, float u, float v)
+{
+    if (tex == NULL)
+        return 0xffffffff;
+
+    int x = (int)(u * tex->width);
+    int y = (int)(v * tex->height);
+    x = x < 0 ? 0 : (x >= tex->width ? tex->width - 1 : x);
+    y = y < 0 ? 0 : (y >= tex->height ? tex->height - 1 : y);
+    int i = y * tex->width + x;
+
+    switch (tex->format)
+    {
+    case SoftTexture::ALPHA8:
+        return ((ImU32)((const uint8_t*)tex->pixels)[i] << 24) | 0x00ffffff;
+    case SoftTexture::INDEXED8:
+        return tex->palette[((const uint8_t*)tex->pixels)[i]];
+    default:
+        return ((const uint32_t*)tex->pixels)[i];
+    }
+}
+
+// Fills 'count' pixels with one colour, four at a time where possible.
+static void FillSpan(uint32_t* dst, int count, ImU32 col)
+{
+    uint32_t a = col >> 24;
+    if (a == 0)
+        return;
+
+    if (a == 255)
+    {
+        uint32_t rgb = Blend(0, col);
+        for (int i = 0; i < count; i++)
+            dst[i] = rgb;
+        return;
+    }
+
+    int i = 0;
+#ifdef IMGUI_SOFT_SSE2
+    // Channels are widened to 16 bits: dst * (255 - a) + src * a + 128 fits.
+    uint32_t ia = 255 - a;
+    uint32_t src = Blend(0, col | 0xff000000);
+    __m128i zero = _mm_setzero_si128();
+    __m128i src16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)src), zero);
+    __m128i premul = _mm_add_epi16(_mm_mullo_epi16(src16, _mm_set1_epi16((short)a)), _mm_set1_epi16(128));
+    __m128i ia16 = _mm_set1_epi16((short)ia);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia16), premul);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia16), premul);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] = Blend(dst[i], col);
+}
+
+// The pixels whose centres lie in [lo, hi).
+static inline void PixelRange(float lo, float hi, int clip_lo, int clip_hi, int& first, int& end)
+{
+    first = (int)ceilf(lo - 0.5f);
+    end = (int)ceilf(hi - 0.5f);
+    if (first < clip_lo) first = clip_lo;
+    if (end > clip_hi) end = clip_hi;
+}
+
+// Axis aligned quads as written by ImDrawList::PrimRect() and PrimRectUV():
+// triangles (a, b, c) and (a, c, d) with a top left and c bottom right.
+static bool IsRect(const ImDrawVert* vtx, const ImDrawIdx* idx)
+{
+    if (idx[3] != idx[0] || idx[4] != idx[2])
+        return false;
+    const ImDrawVert& a = vtx[idx[0]];
+    const ImDrawVert& b = vtx[idx[1]];
+    const ImDrawVert& c = vtx[idx[2]];
+    const ImDrawVert& d = vtx[idx[5]];
+    return a.pos.y == b.pos.y && b.pos.x == c.pos.x && c.pos.y == d.pos.y && d.pos.x == a.pos.x &&
+           a.uv.y == b.uv.y && b.uv.x == c.uv.x && c.uv.y == d.uv.y && d.uv.x == a.uv.x &&
+           a.col == b.col && a.col == c.col && a.col == d.col;
+}
+
+static void DrawRect(const SoftTarget& t, const ImDrawVert& a, const ImDrawVert& c, const SoftTexture* tex)
+{
+    float x_lo = a.pos.x < c.pos.x ? a.pos.x : c.pos.x, x_hi = a.pos.x < c.pos.x ? c.pos.x : a.pos.x;
+    float y_lo = a.pos.y < c.pos.y ? a.pos.y : c.pos.y, y_hi = a.pos.y < c.pos.y ? c.pos.y : a.pos.y;
+    int x0, x1, y0, y1;
+    PixelRange(x_lo, x_hi, t.x0, t.x1, x0, x1);
+    PixelRange(y_lo, y_hi, t.y0, t.y1, y0, y1);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    // Solid rectangles (the white pixel of the font atlas) are one colour.
+    if (tex == NULL || (a.uv.x == c.uv.x && a.uv.y == c.uv.y))
+    {
+        ImU32 col = Modulate(a.col, Sample(tex, a.uv.x, a.uv.y));
+        for (int y = y0; y < y1; y++)
+            FillSpan(t.pixels + y * t.stride + x0, x1 - x0, col);
+        return;
+    }
+
+    float du = (c.uv.x - a.uv.x) / (c.pos.x - a.pos.x);
+    float dv = (c.uv.y - a.uv.y) / (c.pos.y - a.pos.y);
+    for (int y = y0; y < y1; y++)
+    {
+        uint32_t* dst = t.pixels + y * t.stride;
+        float v = a.uv.y + (y + 0.5f - a.pos.y) * dv;
+        for (int x = x0; x < x1; x++)
+        {
+            float u = a.uv.x + (x + 0.5f - a.pos.x) * du;
+            ImU32 col = Modulate(a.col, Sample(tex, u, v));
+            if (col >> 24)
+                dst[x] = Blend(dst[x], col);
+        }
+    }
+}
+
+static void DrawTriangle(const SoftTarget& t, const ImDrawVert* v0, const ImDrawVert* v1, const ImDrawVert* v2, const SoftTexture* tex)
+{
+    float area = (v1->pos.x - v0->pos.x) * (v2->pos.y - v0->pos.y) - (v2->pos.x - v0->pos.x) * (v1->pos.y - v0->pos.y);
+    if (area == 0.0f)
+        return;
+    if (area < 0.0f)
+    {
+        const ImDrawVert* swap = v1; v1 = v2; v2 = swap;
+        area = -area;
+    }
+
+    // Edge i is opposite vertex i: E(x, y) = A * x + B * y + C, positive inside.
+    const ImDrawVert* v[3] = { v0, v1, v2 };
+    float A[3], B[3], C[3];
+    for (int i = 0; i < 3; i++)
+    {
+        const ImVec2& p = v[(i + 1) % 3]->pos;
+        const ImVec2& q = v[(i + 2) % 3]->pos;
+        A[i] = -(q.y - p.y);
+        B[i] = q.x - p.x;
+        C[i] = -A[i] * p.x - B[i] * p.y;
+    }
+
+    float y_lo = Min(v0->pos.y, Min(v1->pos.y, v2->pos.y));
+    float y_hi = Max(v0->pos.y, Max(v1->pos.y, v2->pos.y));
+    int y0, y1;
+    PixelRange(y_lo, y_hi, t.y0, t.y1, y0, y1);
+
+    bool solid_col = v0->col == v1->col && v0->col == v2->col;
+    bool solid_uv = tex == NULL || (v0->uv.x == v1->uv.x && v0->uv.x == v2->uv.x && v0->uv.y == v1->uv.y && v0->uv.y == v2->uv.y);
+    ImU32 solid = Modulate(v0->col, Sample(tex, v0->uv.x, v0->uv.y));
+
+    for (int y = y0; y < y1; y++)
+    {
+        // Intersect the three half planes along this row. Edges facing right
+        // include their boundary and edges facing left exclude it, so two
+        // triangles sharing an edge never both draw a pixel on it.
+        float yc = y + 0.5f;
+        float lo = -1e30f, hi = 1e30f;
+        bool empty = false;
+        for (int i = 0; i < 3; i++)
+        {
+            float e = B[i] * yc + C[i];
+            if (A[i] > 0.0f)
+                lo = Max(lo, -e / A[i]);
+            else if (A[i] < 0.0f)
+                hi = Min(hi, -e / A[i]);
+            else if (e < 0.0f || (e == 0.0f && B[i] < 0.0f))
+                empty = true;
+        }
+        if (empty || lo >= hi)
+            continue;
+
+        int x0, x1;
+        PixelRange(lo, hi, t.x0, t.x1, x0, x1);
+        if (x0 >= x1)
+            continue;
+
+        uint32_t* dst = t.pixels + y * t.stride;
+        if (solid_col && solid_uv)
+        {
+            FillSpan(dst + x0, x1 - x0, solid);
+            continue;
+        }
+
+        for (int x = x0; x < x1; x++)
+        {
+            float xc = x + 0.5f;
+            float w0 = (A[0] * xc + B[0] * yc + C[0]) / area;
+            float w1 = (A[1] * xc + B[1] * yc + C[1]) / area;
+            float w2 = 1.0f - w0 - w1;
+
+            ImU32 col = v0->col;
+            if (!solid_col)
+            {
+                col = 0;
+                for (int shift = 0; shift < 32; shift += 8)
+                {
+                    float c = ((v0->col >> shift) & 0xff) * w0 + ((v1->col >> shift) & 0xff) * w1 + ((v2->col >> shift) & 0xff) * w2;
+                    int ci = (int)(c + 0.5f);
+                    col |= (ImU32)(ci < 0 ? 0 : (ci > 255 ? 255 : ci)) << shift;
+                }
+            }
+            if (!solid_uv)
+                col = Modulate(col, Sample(tex, v0->uv.x * w0 + v1->uv.x * w1 + v2->uv.x * w2, v0->uv.y * w0 + v1->uv.y * w1 + v2->uv.y * w2));
+            else
+                col = Modulate(col, Sample(tex, v0->uv.x, v0->uv.y));
+
+            if (col >> 24)
+                dst[x] = Blend(dst[x], col);
+        }
+    }
+}
+
+// Software Render function.
+void ImGui_ImplSoft_RenderDrawData(ImDrawData* draw_data, void* pixels, int width, int height, int pitch)
+{
+    // Vertices are in ImGui's coordinates, where the framebuffer starts at
+    // DisplayPos ((0,0) for single viewport apps), so the clip rectangles are
+    // kept in those coordinates and the pixels are addressed relative to it.
+    int pos_x = (int)draw_data->DisplayPos.x;
+    int pos_y = (int)draw_data->DisplayPos.y;
+    SoftTarget t;
+    t.stride = pitch / 4;
+    t.pixels = (uint32_t*)pixels - (pos_y * t.stride + pos_x);
+
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        const ImDrawVert* vtx_buffer = cmd_list->VtxBuffer.Data;
+        const ImDrawIdx* idx_buffer = cmd_list->IdxBuffer.Data;
+
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+        {
+            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+            if (pcmd->UserCallback)
+            {
+                // User callback (registered via ImDrawList::AddCallback)
+                pcmd->UserCallback(cmd_list, pcmd);
+                idx_buffer += pcmd->ElemCount;
+                continue;
+            }
+
+            // Apply the clipping rectangle the same way a GL scissor would.
+            t.x0 = Max((int)pcmd->ClipRect.x, pos_x);
+            t.y0 = Max((int)pcmd->ClipRect.y, pos_y);
+            t.x1 = Min((int)pcmd->ClipRect.z, pos_x + width);
+            t.y1 = Min((int)pcmd->ClipRect.w, pos_y + height);
+            if (t.x0 < t.x1 && t.y0 < t.y1)
+            {
+                const SoftTexture* tex = (const SoftTexture*)pcmd->TextureId;
+                for (unsigned int i = 0; i < pcmd->ElemCount; )
+                {
+                    if (i + 6 <= pcmd->ElemCount && IsRect(vtx_buffer, idx_buffer + i))
+                    {
+                        DrawRect(t, vtx_buffer[idx_buffer[i]], vtx_buffer[idx_buffer[i + 2]], tex);
+                        i += 6;
+                    }
+                    else
+                    {
+                        DrawTriangle(t, &vtx_buffer[idx_buffer[i]], &vtx_buffer[idx_buffer[i + 1]], &vtx_buffer[idx_buffer[i + 2]], tex);
+                        i += 3;
+                    }
+                }
+            }
+            idx_buffer += pcmd->ElemCount;
+        }
+    }
+}
@@ -1,5 +1,7 @@
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_opengl2.h"
+#include "imgui/imgui_impl_opengl3.h"
+#include "imgui/imgui_impl_soft.h"
 #include "imgui/imgui_impl_sdl.h"
 
 #include <SDL.h>
@@ -7,23 +9,68 @@
 #include <SDL_thread.h>
 
 #include <stdio.h>
+#include <string.h>
+#include <cfloat>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
 
-#include "CTexture.h"
+#include "CDisplayAtlas.h"
+#include "CDisplayTexture.h"
+#include "Chip8Commands.h"
+#include "Chip8Grid.h"
+#include "Chip8Input.h"
+#include "Chip8Pacer.h"
+#include "Chip8Profiler.h"
+#include "Chip8RomLoader.h"
+#include "Chip8Scaler.h"
 #include "Chip8Sound.h"
+#include "Chip8Trace.h"
+#include "GLFunctions.h"
 #include "chip8.h"
 
 namespace fs = std::filesystem;
 
-enum MachineState { UNDEFINED, INIT, RUNNING, PAUSED, STEP, WAIT, FINISHED };
+enum MachineState { UNDEFINED, RUNNING, PAUSED, WAIT, FINISHED };
 Chip8Sound soundPlayer;
+Chip8Profiler profiler;
+Chip8Tracer tracer;
+Chip8InputQueue inputQueue;
+Chip8CommandQueue commands;
+Chip8Grid grid;
 int emulation_speed = 600;
-MachineState state = UNDEFINED;
+
+//Changed by both the UI and the core thread. The UI changes it through
+//set_state(), which also wakes the core if it is parked.
+std::atomic<MachineState> state{UNDEFINED};
+
+//The core thread parks here while paused, waiting for a step, or stuck in
+//Fx0A, instead of polling. Anything that may give it work bumps core_wakeups.
+std::mutex core_mutex;
+std::condition_variable core_wake;
+uint32_t core_wakeups = 0;
+
+//How the core is paced. SPEED_MULTIPLE runs speed_multiple times real time, in
+//whole 60Hz frames; SPEED_TURBO runs as fast as the host allows. Either way the
+//display still shows the latest frame at the normal rate, and there is no sound.
+enum SpeedMode { SPEED_NORMAL, SPEED_MULTIPLE, SPEED_TURBO };
+std::atomic<int> speed_mode{SPEED_NORMAL};
+std::atomic<int> speed_multiple{4};
+
+//Turbo while Tab is held, whatever mode is selected.
+bool turbo_held = false;
+
+//Paces the core thread. --realtime asks for real-time scheduling for it, and
+//--cpu pins it to one CPU, with or without --realtime.
+Chip8Pacer pacer;
+bool realtime_core = false;
+int core_cpu = -1;
 
 //The window size of this program.
 constexpr int SCREEN_WIDTH = 605;
@@ -33,10 +80,18 @@ constexpr int SCREEN_HEIGHT = 415;
 constexpr int DISPLAY_WIDTH = 64;
 constexpr int DISPLAY_HEIGHT = 32;
 
-constexpr int DISPLAY_X = 0;
-constexpr int DISPLAY_Y = 0;
+constexpr int MAX_FPS = 60;
+
+//When nothing on screen can have changed, the UI stops drawing and sleeps on
+//SDL events, waking every IDLE_POLL_MS to look at the core. It keeps drawing
+//for SETTLE_FRAMES after the last change so ImGui can settle hover states.
+//--always-redraw turns this off.
+constexpr int IDLE_POLL_MS = 100;
+constexpr int SETTLE_FRAMES = 3;
+bool idle_redraw = true;
 
-constexpr int MAX_FPS = 60; //Unused 
+//The quick save slot, written by F7 and loaded by F8.
+std::shared_ptr<Chip8Snapshot> quick_save;
 
 //Default boot ROM to use for initial boot.
 //Simpy prints the word READY to screen.
@@ -102,248 +157,633 @@ unsigned char boot_rom[] =
   0x20,   //001000000
 };
 
-//Reads a chip8 binary ROm and returns the raw byte data.
-//NOTE: Caller must free the memory.
-char* read_rom(fs::path p, std::ifstream::pos_type& size) 
+//Maps each of the 16 chip8 keys (index) to a host key. Edit to change the layout.
+SDL_Keycode keymap[16] = 
+{
+  SDLK_0, SDLK_1, SDLK_2, SDLK_3, SDLK_4, SDLK_5, SDLK_6, SDLK_7,
+  SDLK_8, SDLK_9, SDLK_a, SDLK_b, SDLK_c, SDLK_d, SDLK_e, SDLK_f
+};
+
+//Returns the chip8 key mapped to a host key, or -1 if it isn't mapped.
+int chip8_key(SDL_Keycode sym)
+{
+  for (int i = 0; i < 16; i++)
+  {
+    if (keymap[i] == sym)
+      return i;
+  }
+  return -1;
+}
+
+//Wakes the core thread if it is parked, so it looks at its state again.
+void wake_core()
 {
-  std::ifstream rom_file(p, std::ios::in | std::ios::binary | std::ios::ate);
-  char* memblock;
-
-  if (rom_file.is_open()) {
-    size = rom_file.tellg();
-    memblock = new char[size];
-    rom_file.seekg(0, std::ios::beg);
-    rom_file.read(memblock, size);
-    rom_file.close();
-  } else {
-    std::cout << "Unable to read file: " << p;
-    return 0;
+  {
+    std::lock_guard<std::mutex> lock(core_mutex);
+    core_wakeups++;
   }
+  core_wake.notify_one();
+}
 
-  return memblock;
+void set_state(MachineState next)
+{
+  state = next;
+  wake_core();
 }
 
-//Handles keyboard events.
-MachineState handle_event(SDL_Event event, Chip8* chip8_machine) 
+//Read before the core decides to park, and passed to park_core(), so that a
+//wake up in between isn't missed.
+uint32_t core_wakeup_count()
+{
+  std::lock_guard<std::mutex> lock(core_mutex);
+  return core_wakeups;
+}
+
+//Blocks the core thread until wake_core() is called after 'seen' was read.
+void park_core(uint32_t seen)
+{
+  std::unique_lock<std::mutex> lock(core_mutex);
+  core_wake.wait(lock, [seen] { return core_wakeups != seen; });
+}
+
+//A hash of everything in the register panel, to tell if it needs redrawing.
+uint32_t register_signature(const Chip8* chip8_machine)
 {
-  //MachineState state = RUNNING;
+  uint32_t hash = 2166136261u;
+  auto mix = [&hash](uint32_t value) { hash = (hash ^ value) * 16777619u; };
+
+  for (int i = 0; i < 16; i++)
+  {
+    mix(chip8_machine->V[i]);
+    mix((uint16_t)chip8_machine->Stack[i]);
+  }
+  mix((uint16_t)chip8_machine->PC);
+  mix((uint16_t)chip8_machine->SP);
+  mix(chip8_machine->I);
+  mix(chip8_machine->DT);
+  mix(chip8_machine->ST);
+  return hash;
+}
 
+//Switches the core to a ROM. A cached game resumes where it was left, with
+//the quirks currently ticked, as they are a setting rather than part of it.
+void start_rom(const Chip8Rom& rom, bool shiftUsingVY, bool incrementIOnLD)
+{
+  commands.boot(rom.program.data(), (int32_t)rom.program.size(), rom.snapshot);
+  if (rom.snapshot)
+    commands.set_quirks(shiftUsingVY, incrementIOnLD);
+}
+
+//Handles keyboard events.
+MachineState handle_event(SDL_Event event) 
+{
   if (event.type == SDL_QUIT)
   {
-    state = FINISHED;
+    set_state(FINISHED);
   }
-  else if (event.type == SDL_KEYDOWN) 
+  else if (event.type == SDL_KEYDOWN && !event.key.repeat) 
   {
-    switch (event.key.keysym.sym) 
+    int key = chip8_key(event.key.keysym.sym);
+    if (key >= 0)
     {
-      case SDLK_0: {
-        chip8_machine->keyPressed = 0;
-        break;
-      }
-      case SDLK_1: {
-        chip8_machine->keyPressed = 1;
-        break;
-      }
-      case SDLK_2: {
-        chip8_machine->keyPressed = 2;
-        break;
-      }
-      case SDLK_3: {
-        chip8_machine->keyPressed = 3;
-        break;
-      }
-      case SDLK_4: {
-        chip8_machine->keyPressed = 4;
-        break;
-      }
-      case SDLK_5: {
-        chip8_machine->keyPressed = 5;
-        break;
-      }
-      case SDLK_6: {
-        chip8_machine->keyPressed = 6;
-        break;
-      }
-      case SDLK_7: {
-        chip8_machine->keyPressed = 7;
-        break;
-      }
-      case SDLK_8: {
-        chip8_machine->keyPressed = 8;
-        break;
-      }
-      case SDLK_9: {
-        chip8_machine->keyPressed = 9;
-        break;
-      }
-      case SDLK_a: {
-        chip8_machine->keyPressed = 0xa;
-        break;
-      }
-      case SDLK_b: {
-        chip8_machine->keyPressed = 0xb;
-        break;
-      }
-      case SDLK_c: {
-        chip8_machine->keyPressed = 0xc;
-        break;
-      }
-      case SDLK_d: {
-        chip8_machine->keyPressed = 0xd;
-        break;
-      }
-      case SDLK_e: {
-        chip8_machine->keyPressed = 0xe;
-        break;
-      }
-      case SDLK_f: {
-        chip8_machine->keyPressed = 0xf;
-        break;
-      }
+      inputQueue.push(event.key.timestamp, key, true);
+      grid.set_key(key, true);
+      wake_core();
     }
+    else if (event.key.keysym.sym == SDLK_TAB)
+      turbo_held = true;
   } 
   else if (event.type == SDL_KEYUP) 
   {
+    int key = chip8_key(event.key.keysym.sym);
+    if (key >= 0)
+    {
+      inputQueue.push(event.key.timestamp, key, false);
+      grid.set_key(key, false);
+      wake_core();
+      return state;
+    }
+
     switch (event.key.keysym.sym) 
     {
-      case SDLK_F2: {
-        state = INIT;
-        break;
-      }
-      case SDLK_F6: {
-        state = STEP;
-        break;
-      }
-      case SDLK_F5: {
-        if (state == WAIT)
-        {
-          state = RUNNING;
-        }
-      }
-      case SDLK_0: {
-        chip8_machine->keyPressed = 0xff;
-        break;
-      }
-      case SDLK_1: {
-        chip8_machine->keyPressed = 0xff;
-        break;
-      }
-      case SDLK_2: {
-        chip8_machine->keyPressed = 0xff;
-        break;
-      }
-      case SDLK_3: {
-        chip8_machine->keyPressed = 0xff;
-        break;
-      }
-      case SDLK_4: {
-        chip8_machine->keyPressed = 0xff;
-        break;
-      }
-      case SDLK_5: {
-        chip8_machine->keyPressed = 0xff;
+      case SDLK_TAB: {
+        turbo_held = false;
         break;
       }
-      case SDLK_6: {
-        chip8_machine->keyPressed = 0xff;
+      case SDLK_F2: {
+        commands.reset();
+        set_state(RUNNING);
         break;
       }
-      case SDLK_7: {
-        chip8_machine->keyPressed = 0xff;
+      case SDLK_F6: {
+        set_state(WAIT);
+        commands.step(1);
         break;
       }
-      case SDLK_8: {
-        chip8_machine->keyPressed = 0xff;
+      case SDLK_F7: {
+        //The core saves into a new snapshot, so one still being loaded is untouched.
+        quick_save = std::make_shared<Chip8Snapshot>();
+        commands.save_state(quick_save);
         break;
       }
-      case SDLK_9: {
-        chip8_machine->keyPressed = 0xff;
+      case SDLK_F8: {
+        //Commands run in order, so this is fine even if the save hasn't run yet.
+        if (quick_save)
+          commands.load_state(quick_save);
         break;
       }
-      case SDLK_a: {
-        chip8_machine->keyPressed = 0xff;
+      case SDLK_F5: {
+        if (state == WAIT)
+        {
+          set_state(RUNNING);
+        }
         break;
       }
-      case SDLK_b: {
-        chip8_machine->keyPressed = 0xff;
-        break;
+      case SDLK_ESCAPE: {
+        if (state != PAUSED) {
+          std::cout << "Emulation paused...\n";
+          set_state(PAUSED);
+        }
+        else 
+        {
+          std::cout << "Emulation resumed.\n";
+          set_state(RUNNING);
+        }
       }
-      case SDLK_c: {
-        chip8_machine->keyPressed = 0xff;
+    }
+  }
+  return state;
+}
+
+//Returns how many instructions the next 60Hz timer tick lasts. The emulation
+//speed is spread over the ticks so they average exactly speed / 60, e.g. 10 for
+//600 but 1, 2, 2, 1, ... for 100. The speed slider stops at 60, so a tick is
+//never shorter than one instruction.
+uint32_t next_tick_cycles(int& remainder)
+{
+  remainder += emulation_speed;
+  int cycles = remainder / 60;
+  remainder %= 60;
+  return cycles > 0 ? cycles : 1;
+}
+
+//Executes one instruction. Key events are applied at the instruction
+//scheduled for their time.
+void step_core(Chip8* chip8_machine, uint32_t scheduledTime)
+{
+  inputQueue.apply_due(*chip8_machine, scheduledTime);
+
+  bool tracing = tracer.before_step(*chip8_machine);
+  chip8_machine->step();
+  if (tracing)
+    tracer.after_step(*chip8_machine);
+  if (profiler.enabled)
+    profiler.tick(*chip8_machine);
+}
+
+//Runs every command the UI has queued, in order. Called by the core thread
+//between frames, so a command never lands in the middle of one.
+void run_commands(Chip8* chip8_machine, uint64_t& lastTick, int& tick_remainder)
+{
+  //The program F2 boots again. Core thread only.
+  static std::vector<char> program;
+
+  Chip8Command command;
+  while (commands.pop(command))
+  {
+    switch (command.type)
+    {
+      case CMD_BOOT:
+      case CMD_RESET: {
+        if (command.type == CMD_BOOT)
+          program = std::move(command.program);
+
+        if (command.type == CMD_BOOT && command.snapshot)
+        {
+          //The snapshot holds the whole of memory, program included.
+          chip8_machine->load_state(*command.snapshot);
+        }
+        else
+          chip8_machine->boot(program.data(), (int32_t)program.size());
+        profiler.reset();
         break;
       }
-      case SDLK_d: {
-        chip8_machine->keyPressed = 0xff;
+      case CMD_SET_QUIRKS: {
+        chip8_machine->shiftUsingVY = command.shiftUsingVY;
+        chip8_machine->incrementIOnLD = command.incrementIOnLD;
         break;
       }
-      case SDLK_e: {
-        chip8_machine->keyPressed = 0xff;
+      case CMD_SAVE_STATE: {
+        chip8_machine->save_state(*command.snapshot);
         break;
       }
-      case SDLK_f: {
-        chip8_machine->keyPressed = 0xff;
+      case CMD_LOAD_STATE: {
+        chip8_machine->load_state(*command.snapshot);
         break;
       }
-      case SDLK_ESCAPE: {
-        if (state != PAUSED) {
-          std::cout << "Emulation paused...\n";
-          state = PAUSED;
-        }
-        else 
+      case CMD_STEP: {
+        for (int i = 0; i < command.count; i++)
         {
-          std::cout << "Emulation resumed.\n";
-          state = RUNNING;
+          step_core(chip8_machine, SDL_GetTicks());
+          if (chip8_machine->timerTicks != lastTick)
+          {
+            soundPlayer.render(*chip8_machine);
+            lastTick = chip8_machine->timerTicks;
+            chip8_machine->cyclesPerTick = next_tick_cycles(tick_remainder);
+          }
         }
+        break;
       }
     }
+    command.done.set_value();
   }
-  return state;
 }
 
-//The chip8 emulation runs in its own thread at the prescribed emulation_speed;
-int chip8_thread(void* data) 
+//Runs the core to the end of its current 60Hz frame, or until it stops
+//running. Instruction n of the frame is scheduled n instructions' worth of
+//time after 'startTime'. Returns true if the frame was finished.
+bool run_frame(Chip8* chip8_machine, uint64_t lastTick, uint32_t startTime, double speed)
+{
+  while (chip8_machine->timerTicks == lastTick && state == RUNNING)
+    step_core(chip8_machine, startTime + (uint32_t)(chip8_machine->tickCycle * 1000 / speed));
+
+  return chip8_machine->timerTicks != lastTick;
+}
+
+//Called between frames. If the core is stuck in Fx0A with nothing else going
+//on, every frame until the next key event would be the same, so it sleeps
+//until something wakes it instead. Emulated time stands still meanwhile,
+//which no program can tell. Returns true if it slept.
+bool park_if_idle(Chip8* chip8_machine)
+{
+  uint32_t seen = core_wakeup_count();
+  if (!chip8_machine->idle() || !inputQueue.empty() || commands.pending() || state != RUNNING)
+    return false;
+
+  park_core(seen);
+  return true;
+}
+
+//Runs the core faster than real time, a whole frame at a time, until the
+//speed mode goes back to normal or the machine stops running.
+void run_fast(Chip8* chip8_machine, uint64_t& lastTick, int& tick_remainder)
 {
-  int fps = 0;
+  int multiple = speed_multiple;
+  pacer.start();
 
-  unsigned int last_ticks = SDL_GetTicks();
-  unsigned int target_ticks = 0;
-  unsigned int current_ticks = 0;
+  int mode;
+  while ((mode = speed_mode) != SPEED_NORMAL && state == RUNNING)
+  {
+    if (commands.pending())
+      run_commands(chip8_machine, lastTick, tick_remainder);
+
+    if (!run_frame(chip8_machine, lastTick, SDL_GetTicks(), 1e9))
+      continue;
+
+    //A device can't play faster than real time, so its sound is skipped until
+    //normal speed. Sinks without a clock, like a file, still get every frame.
+    if (soundPlayer.clocked())
+      soundPlayer.skip(*chip8_machine);
+    else
+      soundPlayer.render(*chip8_machine);
+    lastTick = chip8_machine->timerTicks;
+    chip8_machine->cyclesPerTick = next_tick_cycles(tick_remainder);
+
+    if (park_if_idle(chip8_machine))
+    {
+      pacer.start();
+      continue;
+    }
+
+    if (mode == SPEED_TURBO)
+      continue;
+
+    if (multiple != speed_multiple)
+    {
+      multiple = speed_multiple;
+      pacer.start();
+    }
+    pacer.wait_next(1.0 / (60.0 * multiple));
+  }
+}
+
+//The chip8 emulation runs in its own thread at the prescribed emulation_speed,
+//a 60Hz frame's worth of instructions at a time. Each frame is run as soon as
+//it's due, then the pacer waits for the next one.
+int chip8_thread(void* data) 
+{
   Chip8* chip8_machine = (Chip8*)data;
-  //state = RUNNING;
+  uint64_t lastTick = chip8_machine->timerTicks;
+  int tick_remainder = 0;
+  chip8_machine->cyclesPerTick = next_tick_cycles(tick_remainder);
+
+  if (core_cpu >= 0)
+    Chip8Pacer::pin_to_cpu(core_cpu);
+  bool realtime = realtime_core && Chip8Pacer::set_realtime(true);
+
+  bool wasRunning = false;
   while (state != FINISHED) 
   {
-    if (state != PAUSED) 
+    if (commands.pending())
+      run_commands(chip8_machine, lastTick, tick_remainder);
+
+    if (speed_mode != SPEED_NORMAL && state == RUNNING)
     {
-      if (state != WAIT)
-        chip8_machine->step();
-      if (state == STEP)
-        state = WAIT;
+      //Turbo never sleeps, so a real-time core would starve everything else
+      //on its CPU. Fast runs go back to normal priority until they end.
+      if (realtime)
+        Chip8Pacer::set_realtime(false);
+      run_fast(chip8_machine, lastTick, tick_remainder);
+      if (realtime)
+        Chip8Pacer::set_realtime(true);
+      wasRunning = false;
+      continue;
     }
 
-    fps++;
-    float max_frame_ticks = (1000.0 / (float)emulation_speed) + 0.00001;
-    target_ticks = last_ticks + (unsigned int)(fps * max_frame_ticks);
+    if (state == RUNNING)
+    {
+      //Normal pacing starts from now after a pause or fast run, instead of
+      //trying to catch up.
+      if (!wasRunning)
+        pacer.start();
+      wasRunning = true;
+
+      //The audio device is the master clock, so the speed follows its correction.
+      double speed = emulation_speed * soundPlayer.clock_ratio();
+      double frameSeconds = chip8_machine->cyclesPerTick / speed;
+
+      if (run_frame(chip8_machine, lastTick, SDL_GetTicks(), speed))
+      {
+        //Sound is rendered for every frame the core completes.
+        soundPlayer.render(*chip8_machine);
+        lastTick = chip8_machine->timerTicks;
+        chip8_machine->cyclesPerTick = next_tick_cycles(tick_remainder);
+
+        if (park_if_idle(chip8_machine))
+        {
+          wasRunning = false;
+          continue;
+        }
+        pacer.wait_next(frameSeconds);
+      }
+      continue;
+    }
+
+    //Paused, or waiting for the next step. Steps arrive as commands.
+    wasRunning = false;
+    uint32_t seen = core_wakeup_count();
+    MachineState current = state;
+    if (current != RUNNING && current != FINISHED && !commands.pending())
+      park_core(seen);
+  }
+  return 0;
+}
+
+//The image a frame shows: the phosphor glow while persistence is on,
+//otherwise the plain display.
+const uint8_t* frame_image(const Chip8Frame& frame)
+{
+  return frame.glowing ? frame.glow : frame.pixels;
+}
+
+//Glow levels are shown through a ramp between the palette's off and on colours.
+DisplayPalette display_palette(int palette, bool glowing)
+{
+  const DisplayPalette& colours = CDisplayTexture::palettes[palette];
+  return glowing ? CDisplayTexture::ramp(colours) : colours;
+}
+
+#ifdef CHIP8_STATS
+//Shows the core instrumentation counters in a collapsible window.
+void draw_stats_window(Chip8* chip8_machine)
+{
+  const Chip8Stats& stats = chip8_machine->stats;
+
+  ImGui::SetNextWindowPos(ImVec2(SCREEN_WIDTH - 260, 10), ImGuiSetCond_Once);
+  ImGui::SetNextWindowSize(ImVec2(250, 300), ImGuiSetCond_Once);
+  ImGui::SetNextWindowCollapsed(true, ImGuiSetCond_Once);
+  ImGui::Begin("Core Stats");
+
+  ImGui::Text("Instructions: %llu", (unsigned long long)stats.instructions);
+
+  double skipRate = stats.skipsTested ? 100.0 * stats.skipsTaken / stats.skipsTested : 0.0;
+  ImGui::Text("Skips: %llu (%.1f%% taken)", (unsigned long long)stats.skipsTested, skipRate);
 
-    current_ticks = SDL_GetTicks();
-    if (current_ticks < target_ticks) 
+  double collisionRate = stats.drawCalls ? 100.0 * stats.drawCollisions / stats.drawCalls : 0.0;
+  ImGui::Text("DRW: %llu (%.1f%% collided)", (unsigned long long)stats.drawCalls, collisionRate);
+
+  if (ImGui::Button("Dump JSON"))
+  {
+    std::ofstream out("chip8_stats.json");
+    stats.write_json(out);
+    std::cout << "Stats written to chip8_stats.json" << std::endl;
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Reset"))
+    chip8_machine->stats.resetRequested = true;
+
+  if (ImGui::CollapsingHeader("Op classes"))
+  {
+    ImGui::Columns(2, "opcolumns");
+    for (int i = 0; i < OPC_COUNT; i++)
     {
-      SDL_Delay(target_ticks - current_ticks);
-      current_ticks = SDL_GetTicks();
+      if (stats.opClass[i] == 0)
+        continue;
+
+      ImGui::Text("%s", Chip8Stats::op_class_name(i));
+      ImGui::NextColumn();
+      ImGui::Text("%llu", (unsigned long long)stats.opClass[i]);
+      ImGui::NextColumn();
     }
+    ImGui::Columns(1);
+  }
 
-    if (current_ticks - last_ticks >= 1000) 
+  if (ImGui::CollapsingHeader("Hottest addresses"))
+  {
+    //Simple partial selection of the 10 most executed addresses.
+    int hottest[10];
+    int found = 0;
+    for (int i = 0; i < 4096; i++)
     {
-      fps = 0;
-      last_ticks = SDL_GetTicks();
+      if (stats.pcCount[i] == 0)
+        continue;
+
+      //Once the list is full, only an address hotter than the last one gets in.
+      if (found == 10 && stats.pcCount[hottest[9]] >= stats.pcCount[i])
+        continue;
+
+      int pos = found < 10 ? found++ : 9;
+
+      hottest[pos] = i;
+      while (pos > 0 && stats.pcCount[hottest[pos - 1]] < stats.pcCount[hottest[pos]])
+      {
+        int t = hottest[pos - 1];
+        hottest[pos - 1] = hottest[pos];
+        hottest[pos] = t;
+        pos--;
+      }
     }
+
+    for (int i = 0; i < found; i++)
+      ImGui::Text("0x%03x: %llu", hottest[i], (unsigned long long)stats.pcCount[hottest[i]]);
   }
-  return 0;
+
+  ImGui::End();
+}
+#endif
+
+//Shows the audio latency and underrun counters in a collapsible window.
+void draw_audio_window()
+{
+  const AudioStats* stats = soundPlayer.stats();
+  if (stats == NULL)
+    return;
+
+  ImGui::SetNextWindowPos(ImVec2(SCREEN_WIDTH - 260, 40), ImGuiSetCond_Once);
+  ImGui::SetNextWindowSize(ImVec2(250, 260), ImGuiSetCond_Once);
+  ImGui::SetNextWindowCollapsed(true, ImGuiSetCond_Once);
+  ImGui::Begin("Audio");
+
+  ImGui::Text("Callback: %.2f ms (expected %.2f)", stats->lastIntervalUs / 1000.0f,
+              stats->expectedIntervalUs / 1000.0f);
+  ImGui::Text("Jitter: %.2f ms, max %.2f ms", stats->jitterUs / 1000.0f,
+              stats->maxIntervalUs / 1000.0f);
+  ImGui::Text("Underruns: %llu (%llu samples)", (unsigned long long)stats->underruns,
+              (unsigned long long)stats->underrunSamples);
+  ImGui::Text("Overruns: %llu", (unsigned long long)stats->overruns);
+  ImGui::Text("Clock ratio: %.4f", soundPlayer.clock_ratio());
+
+  if (stats->tones > 0)
+  {
+    ImGui::Text("ST to sound: %.1f ms (%.1f - %.1f)", stats->lastToneDelayUs / 1000.0f,
+                stats->minToneDelayUs / 1000.0f, stats->maxToneDelayUs / 1000.0f);
+  }
+
+  float fill[AudioStats::historySize];
+  uint32_t pos = stats->fillHistoryPos;
+  for (int i = 0; i < AudioStats::historySize; i++)
+    fill[i] = (float)stats->fillHistory[(pos + i) % AudioStats::historySize];
+  ImGui::PlotLines("Fill", fill, AudioStats::historySize, 0, NULL, 0.0f, FLT_MAX, ImVec2(0, 50));
+
+  if (ImGui::Button("Dump metrics"))
+  {
+    std::ofstream out("audio_metrics.json");
+    stats->write_json(out);
+    std::cout << "Audio metrics written to audio_metrics.json" << std::endl;
+  }
+
+  ImGui::End();
 }
 
-//Initializes SDL and returns a window handle.
-SDL_Window* initialize_sdl()
+//Copies the latest frame of every grid machine into the atlas, then uploads
+//all of their changes at once. The atlas is rebuilt when machines come or go.
+void update_grid_atlas(CDisplayAtlas& atlas, std::vector<uint32_t>& uploadedSeqs,
+                       DisplayBackend backend, int palette)
 {
-  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_AUDIO) != 0) 
+  bool rebuilt = atlas.tile_count() != grid.size();
+  if (rebuilt)
+  {
+    atlas.init(grid.size(), DISPLAY_WIDTH, DISPLAY_HEIGHT, backend);
+    atlas.set_palette(CDisplayTexture::palettes[palette]);
+    uploadedSeqs.assign(grid.size(), 0);
+  }
+
+  for (int i = 0; i < grid.size(); i++)
+  {
+    Chip8& machine = grid.instance(i).machine;
+    if (!machine.frames.acquire() && !rebuilt)
+      continue;
+
+    //A new atlas starts blank, so every tile is copied whole.
+    const Chip8Frame& frame = machine.frames.front();
+    int firstRow = 0, rows = DISPLAY_HEIGHT;
+    if (rebuilt || frame.dirty_rows(uploadedSeqs[i], firstRow, rows))
+      atlas.set_tile(i, frame.pixels, firstRow, rows);
+    uploadedSeqs[i] = frame.seq;
+  }
+
+  atlas.upload();
+}
+
+//Shows the grid machines. New ones run the ROM selected in the main window,
+//with the quirks set there. Right click a machine to remove it.
+void draw_grid_window(CDisplayAtlas& atlas, const std::string& romName, char* program,
+                      int32_t len, bool shiftUsingVY, bool incrementIOnLD)
+{
+  ImGui::SetNextWindowPos(ImVec2(10, 40), ImGuiSetCond_Once);
+  ImGui::SetNextWindowSize(ImVec2(420, 300), ImGuiSetCond_Once);
+  ImGui::SetNextWindowCollapsed(true, ImGuiSetCond_Once);
+  ImGui::Begin("Grid");
+
+  if (ImGui::Button("Add"))
+    grid.add(romName, program, len, shiftUsingVY, incrementIOnLD);
+  ImGui::SameLine();
+  if (ImGui::Button("Clear"))
+    grid.clear();
+  ImGui::SameLine();
+  ImGui::Text("%d machines", grid.size());
+
+  const ImVec2 tileSize(DISPLAY_WIDTH * 2, DISPLAY_HEIGHT * 2);
+  int perRow = (int)(ImGui::GetContentRegionAvailWidth() / (tileSize.x + ImGui::GetStyle().ItemSpacing.x));
+  if (perRow < 1)
+    perRow = 1;
+
+  int removed = -1;
+  for (int i = 0; i < atlas.tile_count(); i++)
+  {
+    if (i % perRow != 0)
+      ImGui::SameLine();
+
+    atlas.draw_tile(i, tileSize);
+    if (ImGui::IsItemHovered())
+    {
+      const Chip8& machine = grid.instance(i).machine;
+      ImGui::SetTooltip("%s\nVy shift: %s\nIncrement I: %s", grid.instance(i).name.c_str(),
+                        machine.shiftUsingVY ? "on" : "off", machine.incrementIOnLD ? "on" : "off");
+    }
+    if (ImGui::IsItemClicked(1))
+      removed = i;
+  }
+
+  if (removed >= 0)
+    grid.remove(removed);
+
+  ImGui::End();
+}
+
+//Shows how closely the core keeps to its schedule in a collapsible window.
+void draw_timing_window()
+{
+  const PacerStats& stats = pacer.stats;
+
+  ImGui::SetNextWindowPos(ImVec2(SCREEN_WIDTH - 260, 70), ImGuiSetCond_Once);
+  ImGui::SetNextWindowSize(ImVec2(250, 200), ImGuiSetCond_Once);
+  ImGui::SetNextWindowCollapsed(true, ImGuiSetCond_Once);
+  ImGui::Begin("Timing");
+
+  ImGui::Text("Late: %.3f ms, max %.3f ms", stats.lastLateUs / 1000.0f, stats.maxLateUs / 1000.0f);
+  ImGui::Text("Jitter: %.3f ms", stats.jitterUs / 1000.0f);
+  ImGui::Text("Spin: %.3f ms (margin %.3f ms)", stats.spinUs / 1000.0f, stats.spinMarginUs / 1000.0f);
+  ImGui::Text("Frames: %llu, resyncs: %llu", (unsigned long long)stats.waits,
+              (unsigned long long)stats.resyncs);
+
+  float late[PacerStats::historySize];
+  uint32_t pos = stats.lateHistoryPos;
+  for (int i = 0; i < PacerStats::historySize; i++)
+    late[i] = stats.lateHistory[(pos + i) % PacerStats::historySize] / 1000.0f;
+  ImGui::PlotLines("Late ms", late, PacerStats::historySize, 0, NULL, 0.0f, FLT_MAX, ImVec2(0, 50));
+
+  if (ImGui::Button("Reset"))
+    pacer.stats.reset();
+
+  ImGui::End();
+}
+
+//Initializes SDL and returns a window handle. Software rendering needs a
+//window without OpenGL.
+SDL_Window* initialize_sdl(DisplayBackend backend)
+{
+  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) 
   {
     return NULL;
   }
@@ -352,30 +792,184 @@ SDL_Window* initialize_sdl()
   SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
   SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
   SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
-  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
-  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
   SDL_DisplayMode current;
   SDL_GetCurrentDisplayMode(0, &current);
 
   SDL_Window* window = SDL_CreateWindow(
       "Chimp Chip-8 Emulator", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-      SCREEN_WIDTH, SCREEN_HEIGHT, SDL_RENDERER_ACCELERATED);
+      SCREEN_WIDTH, SCREEN_HEIGHT, backend == BACKEND_SOFTWARE ? 0 : SDL_WINDOW_OPENGL);
 
   return window;
 }
 
+//Sets up the ImGui renderer for the backend asked for, creating a GL context
+//unless it is the software one. Falls back from OpenGL 3.2 core profile to
+//OpenGL 2, and from there to software, updating 'backend' to say so.
+SDL_GLContext create_renderer(SDL_Window* window, DisplayBackend& backend)
+{
+  if (backend == BACKEND_GL3)
+  {
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG);
+
+    SDL_GLContext context = SDL_GL_CreateContext(window);
+    if (context != NULL)
+      gl::load();
+    if (context != NULL && ImGui_ImplOpenGL3_Init())
+      return context;
+
+    if (context != NULL)
+    {
+      ImGui_ImplOpenGL3_Shutdown();
+      SDL_GL_DeleteContext(context);
+    }
+    std::cout << "OpenGL 3.2 core profile unavailable, using OpenGL 2." << std::endl;
+    backend = BACKEND_GL2;
+  }
+
+  if (backend == BACKEND_GL2)
+  {
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, 0);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
+
+    SDL_GLContext context = SDL_GL_CreateContext(window);
+    if (context != NULL)
+    {
+      gl::load();
+      ImGui_ImplOpenGL2_Init();
+      return context;
+    }
+    std::cout << "OpenGL unavailable, rendering in software." << std::endl;
+    backend = BACKEND_SOFTWARE;
+  }
+
+  ImGui_ImplSoft_Init();
+  return NULL;
+}
+
+void renderer_new_frame(DisplayBackend backend)
+{
+  if (backend == BACKEND_GL3)
+    ImGui_ImplOpenGL3_NewFrame();
+  else if (backend == BACKEND_GL2)
+    ImGui_ImplOpenGL2_NewFrame();
+  else
+    ImGui_ImplSoft_NewFrame();
+}
+
+//Draws ImGui's output into the window surface on the CPU. The renderer writes
+//XRGB8888, so when the window surface is in another format it draws into
+//'canvas' and SDL converts while blitting.
+void present_software(SDL_Window* window, const ImVec4& clear_color, SDL_Surface*& canvas)
+{
+  SDL_Surface* screen = SDL_GetWindowSurface(window);
+  if (screen == NULL)
+    return;
+
+  SDL_Surface* target = screen;
+  if (screen->format->format != SDL_PIXELFORMAT_RGB888)
+  {
+    if (canvas == NULL || canvas->w != screen->w || canvas->h != screen->h)
+    {
+      SDL_FreeSurface(canvas);
+      canvas = SDL_CreateRGBSurfaceWithFormat(0, screen->w, screen->h, 32, SDL_PIXELFORMAT_RGB888);
+    }
+    target = canvas;
+  }
+
+  SDL_FillRect(target, NULL, SDL_MapRGB(target->format, (Uint8)(clear_color.x * 255),
+                                        (Uint8)(clear_color.y * 255), (Uint8)(clear_color.z * 255)));
+  SDL_LockSurface(target);
+  ImGui_ImplSoft_RenderDrawData(ImGui::GetDrawData(), target->pixels, target->w, target->h,
+                                target->pitch);
+  SDL_UnlockSurface(target);
+
+  if (target != screen)
+    SDL_BlitSurface(canvas, NULL, screen, NULL);
+  SDL_UpdateWindowSurface(window);
+}
+
+//Renders the ImGui frame built since renderer_new_frame() and shows it.
+void renderer_present(SDL_Window* window, DisplayBackend backend, const ImVec4& clear_color,
+                      SDL_Surface*& canvas)
+{
+  ImGui::Render();
+
+  if (backend == BACKEND_SOFTWARE)
+  {
+    present_software(window, clear_color, canvas);
+    return;
+  }
+
+  ImGuiIO& io = ImGui::GetIO();
+  glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
+  glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  if (backend == BACKEND_GL3)
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+  else
+    ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
+  SDL_GL_SwapWindow(window);
+}
+
+void renderer_shutdown(DisplayBackend backend)
+{
+  if (backend == BACKEND_GL3)
+    ImGui_ImplOpenGL3_Shutdown();
+  else if (backend == BACKEND_GL2)
+    ImGui_ImplOpenGL2_Shutdown();
+  else
+    ImGui_ImplSoft_Shutdown();
+}
+
 //The main app setup and loop.
 int main(int argc, char* argv[]) 
 {
+  //--audio-out <file> renders the sound to a .wav (or raw PCM) file instead
+  //of the audio device, and --no-audio discards it. --renderer gl2 picks the
+  //fixed function renderer over the default OpenGL 3 one, and --renderer
+  //software draws without OpenGL at all.
+  const char* audioOut = NULL;
+  bool noAudio = false;
+  DisplayBackend backend = BACKEND_GL3;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--audio-out") == 0 && i + 1 < argc)
+      audioOut = argv[++i];
+    else if (strcmp(argv[i], "--no-audio") == 0)
+      noAudio = true;
+    else if (strcmp(argv[i], "--always-redraw") == 0)
+      idle_redraw = false;
+    else if (strcmp(argv[i], "--realtime") == 0)
+      realtime_core = true;
+    else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc)
+      core_cpu = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--renderer") == 0 && i + 1 < argc)
+    {
+      i++;
+      if (strcmp(argv[i], "gl2") == 0)
+        backend = BACKEND_GL2;
+      else if (strcmp(argv[i], "gl3") == 0)
+        backend = BACKEND_GL3;
+      else if (strcmp(argv[i], "software") == 0)
+        backend = BACKEND_SOFTWARE;
+      else
+        std::cout << "Unknown renderer: " << argv[i] << std::endl;
+    }
+  }
+
   //Initialize SDL first
-  SDL_Window* window = initialize_sdl();
+  SDL_Window* window = initialize_sdl(backend);
   if (window == NULL)
   {
     std::cout << "Error:" << SDL_GetError() << std::endl;
     return -1;
   }
-  SDL_GLContext gl_context = SDL_GL_CreateContext(window);
-  SDL_GL_SetSwapInterval(0);  // Enable vsync
 
   // Setup Dear ImGui context
   IMGUI_CHECKVERSION();
@@ -389,28 +983,57 @@ int main(int argc, char* argv[])
   ImGui::StyleColorsClassic();
   
   // Setup Platform/Renderer bindings
+  SDL_GLContext gl_context = create_renderer(window, backend);
+  SDL_Surface* softwareCanvas = NULL;
+
+  //With vsync the swap paces the UI; otherwise it's held to MAX_FPS below.
+  bool vsync = gl_context != NULL && SDL_GL_SetSwapInterval(1) == 0;
   ImGui_ImplSDL2_InitForOpenGL(window, gl_context);
-  ImGui_ImplOpenGL2_Init();
   ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
   //Initialize the emulator!
   Chip8* chipInstance = new Chip8();
 
-  std::ifstream::pos_type romSize;
   std::string romPath = "./roms";
   const char* defaultRom = "./roms/BLITZ.ch8";
-  char* memBlock = NULL;
 
-  std::cout << "Booting..." << std::endl;
-  chipInstance->boot((char*)boot_rom, sizeof(boot_rom));
+  //ROM files are read in the background, and recently played ones are kept
+  //with their state. 'currentRom' has no path while the boot ROM is running.
+  Chip8RomLoader romLoader;
+  Chip8Rom currentRom;
+
+  //Everything that changes the whole machine goes through the core thread,
+  //starting with the boot ROM, which it runs as soon as it starts.
+  commands.notify = wake_core;
+  commands.boot((char*)boot_rom, sizeof(boot_rom));
   std::cout << "Ready. Select a ROM." << std::endl;
 
-  soundPlayer.init();
+  if (noAudio)
+    soundPlayer.init_null();
+  else if (audioOut != NULL)
+  {
+    if (!soundPlayer.init_file(audioOut))
+    {
+      std::cout << "Unable to write audio to: " << audioOut << std::endl;
+      soundPlayer.init_null();
+    }
+  }
+  else
+    soundPlayer.init();
 
   bool done = false;
-  CTexture emuTexture;
+  CDisplayTexture emuTexture;
+  Chip8Scaler scaler;
+  int palette = 0;
 
-  emuTexture.init(chipInstance->display, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+  chipInstance->frames.acquire();
+  emuTexture.init(chipInstance->frames.front().pixels, DISPLAY_WIDTH, DISPLAY_HEIGHT, backend);
+  uint32_t uploadedSeq = chipInstance->frames.front().seq;
+  bool glowShown = false;
+
+  CDisplayAtlas gridAtlas;
+  std::vector<uint32_t> gridSeqs;
+  gridAtlas.init(0, DISPLAY_WIDTH, DISPLAY_HEIGHT, backend);
 
   std::string buttonText[16] = {"0", "1", "2", "3", "4", "5", "6", "7",
                                  "8", "9", "A", "B", "C", "D", "E", "F"};
@@ -418,6 +1041,7 @@ int main(int argc, char* argv[])
   unsigned int lastTicks = SDL_GetTicks();
   unsigned int targetTicks = 0;
   unsigned int currentTicks = 0;
+  unsigned int frameCount = 0;
 
   struct rom_files 
   {
@@ -445,47 +1069,90 @@ int main(int argc, char* argv[])
   SDL_Thread* threadID =
       SDL_CreateThread(chip8_thread, "Chip8CoreThread", (void*)chipInstance);
 
-  state = RUNNING;
+  set_state(RUNNING);
+
+  uint32_t shownSignature = 0;
+  int quietFrames = 0;
+
   // Main loop
   while (!done) 
   {
     SDL_Event event;
+    bool haveEvent = SDL_PollEvent(&event) != 0;
+
+    //Nothing has changed for a while, so sleep until an event arrives or it's
+    //time to look at the core again.
+    if (!haveEvent && idle_redraw && quietFrames >= SETTLE_FRAMES)
+      haveEvent = SDL_WaitEventTimeout(&event, IDLE_POLL_MS) != 0;
 
-    while (SDL_PollEvent(&event)) 
+    bool input = haveEvent;
+    for (; haveEvent; haveEvent = SDL_PollEvent(&event) != 0)
     {
       ImGui_ImplSDL2_ProcessEvent(&event);
-      state = handle_event(event, chipInstance);
+      MachineState current = handle_event(event);
 
-      if (state == FINISHED)
+      if (current == FINISHED)
       {
         done = true;
       }
-      else if (state == INIT)
-      {
-        state = RUNNING;
-        chipInstance->boot(memBlock, romSize);
-      }
     }
 
-    // ST and DT are decremented at 60Hz
-    if (chipInstance->DT > 0) chipInstance->DT--;
-
-    if (chipInstance->ST > 0) 
-    {
-      chipInstance->ST--;
-      soundPlayer.play_ring_buffer(true);
-    } 
-    else
-      soundPlayer.play_ring_buffer(false);
+    //Redraw if the core published a frame, the registers moved, anything was
+    //input, or something shown is live (running grid machines, profiling or
+    //tracing). Otherwise the last frame drawn is still right.
+    bool newFrame = chipInstance->frames.acquire();
+    uint32_t signature = register_signature(chipInstance);
+    bool live = (grid.size() > 0 && !grid.is_paused()) || profiler.enabled || tracer.is_active() ||
+                romLoader.loading();
+    if (newFrame || input || live || signature != shownSignature)
+      quietFrames = 0;
+    else if (quietFrames < SETTLE_FRAMES)
+      quietFrames++;
+    shownSignature = signature;
+
+    //A minimised window isn't drawn at all, and its swaps wouldn't wait for vsync.
+    if (idle_redraw && (SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED))
+      quietFrames = SETTLE_FRAMES;
+
+    if (done || (idle_redraw && quietFrames >= SETTLE_FRAMES))
+      continue;
 
     // Start the Dear ImGui frame
-    ImGui_ImplOpenGL2_NewFrame();
+    renderer_new_frame(backend);
     ImGui_ImplSDL2_NewFrame(window);
     ImGui::NewFrame();
 
-    //Update the display contents
-    emuTexture.update(chipInstance->display);
-    emuTexture.render(DISPLAY_X, DISPLAY_Y);
+    //Update the display contents with the latest frame the core published,
+    //sending only the rows that changed since the last upload.
+    if (chipInstance->frames.front().seq != uploadedSeq)
+    {
+      const Chip8Frame& frame = chipInstance->frames.front();
+      int firstRow, rows;
+      bool changed = frame.dirty_rows(uploadedSeq, firstRow, rows);
+
+      //Switching between glow and plain pixels changes every row and the colours.
+      if (frame.glowing != glowShown)
+      {
+        glowShown = frame.glowing;
+        emuTexture.set_palette(display_palette(palette, glowShown));
+        firstRow = 0;
+        rows = DISPLAY_HEIGHT;
+        changed = true;
+      }
+
+      if (changed)
+      {
+        const uint8_t* image = scaler.scale(frame_image(frame), DISPLAY_WIDTH, DISPLAY_HEIGHT);
+        scaler.scaled_rows(firstRow, rows, DISPLAY_HEIGHT, firstRow, rows);
+        emuTexture.update(image, firstRow, rows);
+      }
+      uploadedSeq = frame.seq;
+    }
+
+    //The grid follows the main machine's speed and pausing.
+    grid.speed = emulation_speed;
+    grid.set_paused(state == PAUSED || state == WAIT);
+    update_grid_atlas(gridAtlas, gridSeqs, backend, palette);
 
     static float f = 0.0f;
     static int counter = 0;
@@ -506,8 +1173,7 @@ int main(int argc, char* argv[])
 
     ImGui::BeginChild("Child1", ImVec2(DISPLAY_WIDTH * 6, 0), false,
                       window_flags);
-      ImGui::Image((void*)(intptr_t)emuTexture.get_texture_id(),
-                  ImVec2(DISPLAY_WIDTH * 6, DISPLAY_HEIGHT * 6));
+      emuTexture.draw(ImVec2(DISPLAY_WIDTH * 6, DISPLAY_HEIGHT * 6));
       ImGui::Separator();
       if (ImGui::BeginCombo("ROM File", romList[selected].name.c_str())) 
       {
@@ -515,29 +1181,95 @@ int main(int argc, char* argv[])
           if (ImGui::Selectable(romList[n].name.c_str(), selected == n)) 
           {
             selected = n;
-            delete[] memBlock;
             std::cout << "ROM selected: " << romList[n].name.c_str() << std::endl;
-            memBlock = read_rom(romList[n].romPath, romSize);
-            chipInstance->boot(memBlock, romSize);
+
+            //Keep where the outgoing game was, for when it's picked again.
+            //Picking the running game again reboots it, as it always has.
+            std::string path = romList[n].romPath.string();
+            if (path == currentRom.path)
+              romLoader.set_snapshot(path, nullptr);
+            else if (!currentRom.path.empty())
+            {
+              std::shared_ptr<Chip8Snapshot> left = std::make_shared<Chip8Snapshot>();
+              commands.save_state(left);
+              romLoader.set_snapshot(currentRom.path, left);
+            }
+
+            Chip8Rom rom;
+            if (romLoader.request(path, rom))
+            {
+              start_rom(rom, useOriginalShiftMethod, incrementIonLDOperation);
+              currentRom = rom;
+            }
           }
         ImGui::EndCombo();
       }
 
-      ImGui::SliderInt("Emulation Speed", &emulation_speed, 10, 1000);
+      //The file of a ROM that wasn't cached has been read.
+      Chip8Rom loaded;
+      if (romLoader.poll(loaded) && !loaded.program.empty())
+      {
+        start_rom(loaded, useOriginalShiftMethod, incrementIonLDOperation);
+        currentRom = loaded;
+      }
+
+      ImGui::SliderInt("Emulation Speed", &emulation_speed, 60, 1000);
+
+      static int speedMode = SPEED_NORMAL;
+      static int multiple = speed_multiple;
+      ImGui::Combo("Speed Mode", &speedMode, "Normal\0Fast forward\0Turbo\0");
+      if (speedMode == SPEED_MULTIPLE && ImGui::SliderInt("Times Real Time", &multiple, 2, 16))
+        speed_multiple = multiple;
+      speed_mode = turbo_held ? SPEED_TURBO : speedMode;
+
+      static float toneHz = soundPlayer.toneHz;
+      static float volume = soundPlayer.volume;
+      if (ImGui::SliderFloat("Tone Hz", &toneHz, 110.0f, 1760.0f, "%.0f"))
+        soundPlayer.toneHz = toneHz;
+      if (ImGui::SliderFloat("Volume", &volume, 0.0f, 1.0f, "%.2f"))
+        soundPlayer.volume = volume;
+
+      if (ImGui::Combo("Palette", &palette, [](void*, int n, const char** name) {
+            *name = CDisplayTexture::palettes[n].name;
+            return true;
+          }, NULL, CDisplayTexture::paletteCount))
+      {
+        emuTexture.set_palette(display_palette(palette, glowShown));
+        gridAtlas.set_palette(CDisplayTexture::palettes[palette]);
+      }
+
+      //How much of its brightness a pixel keeps each 60Hz frame after going off.
+      static float persistence = 0.0f;
+      if (ImGui::SliderFloat("Persistence", &persistence, 0.0f, 0.95f, "%.2f"))
+      {
+        chipInstance->phosphor.set_persistence(persistence);
+        wake_core();
+      }
 
-      if (ImGui::Checkbox("Use Vy for shift operations", &useOriginalShiftMethod))
-        chipInstance->shiftUsingVY = useOriginalShiftMethod;
+      static int scaleFilter = SCALE_NONE;
+      if (ImGui::Combo("Upscaler", &scaleFilter, [](void*, int n, const char** name) {
+            *name = Chip8Scaler::filter_name(n);
+            return true;
+          }, NULL, SCALE_FILTER_COUNT))
+      {
+        //The texture changes size, so it's made again from the latest frame.
+        const Chip8Frame& frame = chipInstance->frames.front();
+        scaler.set_filter((ScaleFilter)scaleFilter);
+        scaler.scale(frame_image(frame), DISPLAY_WIDTH, DISPLAY_HEIGHT);
+        emuTexture.init(scaler.image(), scaler.image_width(), scaler.image_height(), backend);
+        uploadedSeq = frame.seq;
+      }
 
-      if (ImGui::Checkbox("Increment I on LD Vx operations", &incrementIonLDOperation))
-        chipInstance->incrementIOnLD = incrementIonLDOperation;
+      bool quirksChanged = ImGui::Checkbox("Use Vy for shift operations", &useOriginalShiftMethod);
+      quirksChanged |= ImGui::Checkbox("Increment I on LD Vx operations", &incrementIonLDOperation);
+      if (quirksChanged)
+        commands.set_quirks(useOriginalShiftMethod, incrementIonLDOperation);
 
       //Hack to align text at bottom of the window.
       ImGui::NewLine();
-      ImGui::NewLine();
-      ImGui::NewLine();
       
-      ImGui::Text("ESC = Pause/Resume.  F2 = Reset. F6 = Step Into.");
-      ImGui::NewLine();
+      ImGui::Text("ESC = Pause/Resume.  F2 = Reset. F6 = Step Into. Tab = Turbo.");
+      ImGui::Text("F7 = Save State. F8 = Load State.");
       if (state == PAUSED || state == WAIT) 
       {
         ImGui::Text("Emulation PAUSED...");
@@ -546,6 +1278,21 @@ int main(int argc, char* argv[])
       {
         ImGui::Text("Framerate: %.3f ms/frame (%.1f FPS)",
                   1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+
+        //Emulated 60Hz frames per real one, measured over half a second.
+        static uint64_t measuredTicks = chipInstance->sharedTimerTicks;
+        static uint32_t measuredAt = SDL_GetTicks();
+        static float realTimeRatio = 1.0f;
+        uint32_t now = SDL_GetTicks();
+        if (now - measuredAt >= 500)
+        {
+          uint64_t ticks = chipInstance->sharedTimerTicks;
+          realTimeRatio = (ticks - measuredTicks) * 1000.0f / (60.0f * (now - measuredAt));
+          measuredTicks = ticks;
+          measuredAt = now;
+        }
+        if (speed_mode != SPEED_NORMAL)
+          ImGui::Text("Speed: %.1fx real time", realTimeRatio);
       }
   
     ImGui::EndChild();
@@ -576,41 +1323,104 @@ int main(int argc, char* argv[])
       ImGui::Text("DT: %d", chipInstance->DT);
       ImGui::Text("ST: %d", chipInstance->ST);
       ImGui::Text("I : %d", chipInstance->I);
+      ImGui::Separator();
+
+      //Live view of the guest profiler.
+      static bool profiling = false;
+      if (ImGui::Checkbox("Profile", &profiling))
+        profiler.enabled = profiling;
+      ImGui::SameLine();
+      if (ImGui::Button("Save"))
+      {
+        if (profiler.write_folded("chip8_profile.folded"))
+          std::cout << "Profile written to chip8_profile.folded" << std::endl;
+      }
+
+      //Full execution trace, decoded with the trace_reader tool.
+      bool tracing = tracer.is_active();
+      if (ImGui::Checkbox("Trace", &tracing))
+      {
+        if (tracing)
+        {
+          if (!tracer.start("chip8_trace.c8t"))
+            std::cout << "Unable to open chip8_trace.c8t" << std::endl;
+        }
+        else
+        {
+          tracer.stop();
+          std::cout << "Trace written to chip8_trace.c8t" << std::endl;
+        }
+      }
+      if (tracer.is_active())
+        ImGui::Text("%llu KB", (unsigned long long)tracer.bytes_written() / 1024);
+
+      uint64_t samples = profiler.sample_count();
+      if (samples > 0)
+      {
+        ImGui::Text("Hot subroutines (self/total)");
+        for (const auto& entry : profiler.hot_subroutines(8))
+        {
+          ImGui::Text("%03x: %4.1f%% %4.1f%%", entry.address,
+                      100.0 * entry.self / samples, 100.0 * entry.total / samples);
+        }
+      }
 
     ImGui::EndChild();
     ImGui::PopStyleVar();
     ImGui::End();
 
-    glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-    glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
-    glClear(GL_COLOR_BUFFER_BIT);
+#ifdef CHIP8_STATS
+    draw_stats_window(chipInstance);
+#endif
+    draw_audio_window();
+    draw_timing_window();
+    if (!currentRom.path.empty())
+      draw_grid_window(gridAtlas, fs::path(currentRom.path).filename().string(),
+                       currentRom.program.data(), (int32_t)currentRom.program.size(),
+                       useOriginalShiftMethod, incrementIonLDOperation);
+    else
+      draw_grid_window(gridAtlas, "Boot", (char*)boot_rom, sizeof(boot_rom),
+                       useOriginalShiftMethod, incrementIonLDOperation);
 
-    ImGui::Render();
+    renderer_present(window, backend, clear_color, softwareCanvas);
 
-    // glUseProgram(0); // You may want this if using this code in an OpenGL 3+
-                        // context where shaders may be bound
-    ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
-    SDL_GL_SwapWindow(window);
+    // Limit the frame rate to MAX_FPS, unless vsync already does.
+    if (vsync)
+      continue;
 
-    // The sound is synchronized at 60Hz, so we will use this to limit the frame
-    // rate as well.
-    while (soundPlayer.AudioRingBuffer.Length > 0) 
+    frameCount++;
+    targetTicks = lastTicks + (unsigned int)(frameCount * 1000.0 / MAX_FPS);
+    currentTicks = SDL_GetTicks();
+    if (currentTicks < targetTicks)
+    {
+      SDL_Delay(targetTicks - currentTicks);
+    }
+    else if (currentTicks - targetTicks > 100)
     {
-      SDL_Delay(1);
+      //Fell well behind (e.g. a window drag), so don't try to catch up.
+      frameCount = 0;
+      lastTicks = currentTicks;
     }
   }
 
   SDL_WaitThread(threadID, NULL);
+  tracer.stop();
+  soundPlayer.close();
 
   // Cleanup
+  grid.stop();
+  grid.clear();
   delete chipInstance;
-  delete[] memBlock;
 
-  ImGui_ImplOpenGL2_Shutdown();
+  emuTexture.free_texture();
+  gridAtlas.free_texture();
+  renderer_shutdown(backend);
   ImGui_ImplSDL2_Shutdown();
   ImGui::DestroyContext();
 
-  SDL_GL_DeleteContext(gl_context);
+  SDL_FreeSurface(softwareCanvas);
+  if (gl_context != NULL)
+    SDL_GL_DeleteContext(gl_context);
   SDL_DestroyWindow(window);
   SDL_Quit();
 
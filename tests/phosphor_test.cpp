@@ -0,0 +1,58 @@
+/** Runs phosphor persistence over random frames and prints  **/
+/** a hash of each glow plane and the rows each fade marked. **/
+/** Like the scaler test, it is built with and without       **/
+/** CHIP8_NO_SIMD and the two outputs must match.            **/
+
+#include <cstdint>
+#include <cstdio>
+
+#include "Chip8Phosphor.h"
+
+static uint32_t rng = 0x9e3779b9;
+static uint32_t next_random()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static uint32_t hash(const uint8_t *data, size_t len)
+{
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+    h = (h ^ data[i]) * 16777619u;
+  return h;
+}
+
+int main()
+{
+  static Chip8Phosphor phosphor;
+  static uint8_t display[64 * 32];
+  static uint8_t glow[64 * 32];
+
+  //Includes 0, so the levels also get cleared when persistence comes back on.
+  const float persistence[] = {0.5f, 0.9f, 0.0f, 0.75f, 0.99f, 0.1f};
+
+  for (float kept : persistence)
+  {
+    phosphor.set_persistence(kept);
+
+    for (int frame = 0; frame < 64; frame++)
+    {
+      //A sparse picture, so most pixels spend a few frames fading.
+      for (auto &pixel : display)
+        pixel = (next_random() & 0x7) == 0 ? 1 : 0;
+
+      phosphor.light(display, glow);
+      printf("%.2f %d light %08x\n", kept, frame, hash(glow, sizeof(glow)));
+
+      //Several 60Hz ticks can pass between two published frames.
+      int ticks = next_random() % 4;
+      for (int t = 0; t < ticks; t++)
+        printf("%.2f %d fade %08x\n", kept, frame, phosphor.fade(display));
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,68 @@
+/** Scales random frames with every filter and prints a hash **/
+/** of each result. The test target builds this once as is   **/
+/** and once with CHIP8_NO_SIMD, and the two outputs must    **/
+/** match byte for byte.                                     **/
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "Chip8Scaler.h"
+
+//Small xorshift so both builds see exactly the same frames.
+static uint32_t rng = 0x12345678;
+static uint32_t next_random()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static uint32_t hash(const uint8_t *data, size_t len)
+{
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+    h = (h ^ data[i]) * 16777619u;
+  return h;
+}
+
+int main()
+{
+  //The chip8 and SCHIP sizes, plus widths that leave every possible tail
+  //behind the sixteen pixel SIMD steps.
+  const int sizes[][2] = {{64, 32}, {128, 64}, {1, 1}, {15, 3}, {17, 5}, {33, 9}, {47, 2}, {100, 7}};
+
+  Chip8Scaler scaler;
+  std::vector<uint8_t> frame;
+
+  for (const auto &size : sizes)
+  {
+    int width = size[0];
+    int height = size[1];
+    frame.resize(width * height);
+
+    for (int pass = 0; pass < 16; pass++)
+    {
+      //Mostly two colours so the filters find plenty of edges, with the odd
+      //extra index thrown in.
+      for (auto &pixel : frame)
+      {
+        uint32_t r = next_random();
+        pixel = (r & 0xf) == 0 ? (r >> 4) & 0xff : (r >> 8) & 1;
+      }
+
+      for (int filter = SCALE_NONE; filter < SCALE_FILTER_COUNT; filter++)
+      {
+        scaler.set_filter((ScaleFilter)filter);
+        const uint8_t *out = scaler.scale(frame.data(), width, height);
+
+        printf("%s %dx%d %d: %dx%d %08x\n", Chip8Scaler::filter_name(filter), width, height, pass,
+               scaler.image_width(), scaler.image_height(),
+               hash(out, (size_t)scaler.image_width() * scaler.image_height()));
+      }
+    }
+  }
+
+  return 0;
+}
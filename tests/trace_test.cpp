@@ -0,0 +1,143 @@
+/** Feeds the execution tracer random machine states, then  **/
+/** decodes the file and checks every record comes back     **/
+/** exactly as it was captured.                              **/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Chip8.h"
+#include "Chip8Trace.h"
+
+static uint32_t rng = 0x2545f491;
+static uint32_t next_random()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static bool same(const TraceRecord &a, const TraceRecord &b)
+{
+  return a.cycle == b.cycle && a.pc == b.pc && a.opcode == b.opcode && a.I == b.I && a.SP == b.SP &&
+         a.DT == b.DT && a.ST == b.ST && memcmp(a.V, b.V, sizeof(a.V)) == 0 &&
+         a.memLen == b.memLen && (a.memLen == 0 || a.memAddr == b.memAddr) &&
+         memcmp(a.mem, b.mem, a.memLen) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *path = argc > 1 ? argv[1] : "trace_test.c8t";
+
+  //More than two blocks' worth, so decoding has to restart at a block boundary.
+  const int count = 40000;
+
+  static Chip8 chip;
+  Chip8Tracer tracer;
+  std::vector<TraceRecord> expected;
+
+  if (!tracer.start(path))
+  {
+    printf("Unable to write trace: %s\n", path);
+    return 1;
+  }
+
+  chip.PC = chip.ROMTOP;
+  for (int n = 0; n < count; n++)
+  {
+    uint32_t r = next_random();
+
+    //Mostly straight line code over a small program, with jumps, and now and
+    //then an opcode rewritten in place to defeat the opcode cache.
+    if ((r & 0x7) == 0)
+      chip.PC = chip.ROMTOP + (next_random() & 0x1fe);
+    if ((r & 0x38) == 0 || chip.Memory[chip.PC & 0xfff] == 0)
+    {
+      uint16_t opcode = next_random() & 0xffff;
+      if ((r & 0x1c0) == 0)
+        opcode = 0xf000 | ((next_random() & 0xf) << 8) | ((r & 0x200) ? 0x55 : 0x33);
+      chip.Memory[chip.PC & 0xfff] = opcode >> 8;
+      chip.Memory[(chip.PC + 1) & 0xfff] = opcode & 0xff;
+    }
+
+    TraceRecord record;
+    record.pc = chip.PC & 0xfff;
+    record.opcode = (chip.Memory[record.pc] << 8) | chip.Memory[(record.pc + 1) & 0xfff];
+    record.memAddr = chip.I & 0xfff;
+    record.memLen = 0;
+    if (mask_xh(record.opcode) == 0xf && mask_low(record.opcode) == 0x33)
+      record.memLen = 3;
+    else if (mask_xh(record.opcode) == 0xf && mask_low(record.opcode) == 0x55)
+      record.memLen = mask_xl(record.opcode) + 1;
+
+    if (!tracer.before_step(chip))
+    {
+      printf("Tracer stopped at record %d\n", n);
+      return 1;
+    }
+
+    //What the instruction did.
+    chip.cycles += (r & 0x400) ? 1 + (next_random() & 0xffff) : 1;
+    chip.PC += 2;
+    for (int i = 0; i < 16; i++)
+    {
+      if ((next_random() & 0x7) == 0)
+        chip.V[i] = next_random() & 0xff;
+    }
+    if ((r & 0x1800) == 0)
+      chip.I = next_random() & 0xffff;
+    if ((r & 0x6000) == 0)
+      chip.SP = (int32_t)(next_random() % 17) - 1;
+    if ((r & 0x18000) == 0)
+    {
+      chip.DT = next_random() & 0xff;
+      chip.ST = next_random() & 0xff;
+    }
+    for (int i = 0; i < record.memLen; i++)
+      chip.Memory[(record.memAddr + i) & 0xfff] = next_random() & 0xff;
+
+    tracer.after_step(chip);
+
+    record.cycle = chip.cycles;
+    record.I = chip.I;
+    record.SP = chip.SP;
+    record.DT = chip.DT;
+    record.ST = chip.ST;
+    memcpy(record.V, chip.V, sizeof(record.V));
+    for (int i = 0; i < record.memLen; i++)
+      record.mem[i] = chip.Memory[(record.memAddr + i) & 0xfff];
+    expected.push_back(record);
+  }
+  tracer.stop();
+
+  Chip8TraceReader reader;
+  if (!reader.open(path))
+  {
+    printf("Unable to read trace: %s\n", path);
+    return 1;
+  }
+
+  TraceRecord decoded;
+  size_t n = 0;
+  for (; reader.next(decoded); n++)
+  {
+    if (n >= expected.size() || !same(decoded, expected[n]))
+    {
+      printf("Record %zu doesn't match\n", n);
+      return 1;
+    }
+  }
+  reader.close();
+  remove(path);
+
+  if (n != expected.size())
+  {
+    printf("Decoded %zu of %zu records\n", n, expected.size());
+    return 1;
+  }
+
+  printf("%zu trace records round-tripped\n", n);
+  return 0;
+}
@@ -0,0 +1,65 @@
+/** Command line tool that decodes a trace written by the  **/
+/** emulator's execution tracer into readable text.         **/
+/** Usage: trace_reader <file.c8t> [first cycle] [count]    **/
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "Chip8Trace.h"
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    printf("Usage: %s <trace file> [first cycle] [count]\n", argv[0]);
+    return 1;
+  }
+
+  uint64_t firstCycle = argc > 2 ? strtoull(argv[2], NULL, 0) : 0;
+  uint64_t count = argc > 3 ? strtoull(argv[3], NULL, 0) : UINT64_MAX;
+
+  Chip8TraceReader reader;
+  if (!reader.open(argv[1]))
+  {
+    printf("Unable to open trace: %s\n", argv[1]);
+    return 1;
+  }
+
+  TraceRecord r;
+  TraceRecord prev = {};
+  uint64_t printed = 0;
+
+  while (printed < count && reader.next(r))
+  {
+    if (r.cycle >= firstCycle)
+    {
+      printf("%10llu  %03x  %04x ", (unsigned long long)r.cycle, r.pc, r.opcode);
+
+      //Only print what the instruction changed.
+      for (int32_t i = 0; i < 16; i++)
+      {
+        if (r.V[i] != prev.V[i])
+          printf(" V%X=%02x", i, r.V[i]);
+      }
+      if (r.I != prev.I)
+        printf(" I=%03x", r.I);
+      if (r.SP != prev.SP)
+        printf(" SP=%d", r.SP);
+      if (r.DT != prev.DT)
+        printf(" DT=%d", r.DT);
+      if (r.ST != prev.ST)
+        printf(" ST=%d", r.ST);
+      if (r.memLen > 0)
+      {
+        printf(" [%03x]=", r.memAddr);
+        for (int32_t i = 0; i < r.memLen; i++)
+          printf("%02x", r.mem[i]);
+      }
+      printf("\n");
+      printed++;
+    }
+    prev = r;
+  }
+
+  return 0;
+}